@@ -0,0 +1,85 @@
+#!/bin/bash
+# Frontend/codegen microbenchmark on a synthetic 100k-statement module.
+#
+# Usage: bench/codegen_dispatch.sh [compiler] [baseline-compiler]
+#
+# Generates one module with FUNCS functions of STMTS statements each (default
+# 1000 x 100), compiles it with --emit-llvm RUNS times and reports the best
+# wall time, plus the codegen time from --stats when the compiler prints it.
+# Pass a second compiler built from an older revision to compare the two.
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+COMPILER="${1:-$SCRIPT_DIR/../build/raccoonc}"
+BASELINE="$2"
+FUNCS="${FUNCS:-1000}"
+STMTS="${STMTS:-100}"
+RUNS="${RUNS:-5}"
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+SOURCE="$WORK_DIR/synthetic.rac"
+
+generate() {
+    for ((f = 0; f < FUNCS; f++)); do
+        echo "fun f$f(a: i32, b: i32): i32 {"
+        echo "    let x = a;"
+        for ((s = 0; s < STMTS - 3; s++)); do
+            case $((s % 4)) in
+                0) echo "    x = x + b * $s;" ;;
+                1) echo "    if (x > $s) { x = x - 1; }" ;;
+                2) echo "    let y$s = !(x == b);" ;;
+                3) echo "    x = -x + a;" ;;
+            esac
+        done
+        echo "    let r = x;"
+        echo "    return r;"
+        echo "}"
+    done
+    echo "fun main(): i32 {"
+    echo "    return f0(1, 2) - f0(1, 2);"
+    echo "}"
+}
+
+# Prints "<best wall ms> <best codegen ms or ->" over RUNS compiles.
+measure() {
+    local compiler="$1"
+    local best_wall=""
+    local best_codegen="-"
+    for ((i = 0; i < RUNS; i++)); do
+        local start end wall codegen
+        start=$(date +%s%N)
+        codegen=$("$compiler" --emit-llvm --stats "$SOURCE" \
+            -o "$WORK_DIR/out.ll" 2>/dev/null |
+            sed -n 's/.*: codegen \([0-9.]*\) ms/\1/p')
+        end=$(date +%s%N)
+        wall=$(( (end - start) / 1000000 ))
+        if [ -z "$best_wall" ] || [ "$wall" -lt "$best_wall" ]; then
+            best_wall="$wall"
+        fi
+        if [ -n "$codegen" ] && { [ "$best_codegen" = "-" ] ||
+            awk "BEGIN { exit !($codegen < $best_codegen) }"; }; then
+            best_codegen="$codegen"
+        fi
+    done
+    echo "$best_wall $best_codegen"
+}
+
+report() {
+    echo "  total ${1} ms, codegen ${2} ms  [$3]"
+}
+
+generate > "$SOURCE"
+echo "Synthetic module: $FUNCS functions x $STMTS statements" \
+    "($(wc -l < "$SOURCE") lines)"
+
+echo "Best of $RUNS runs:"
+read -r cur_wall cur_codegen <<< "$(measure "$COMPILER")"
+report "$cur_wall" "$cur_codegen" "$COMPILER"
+
+if [ -n "$BASELINE" ]; then
+    read -r base_wall base_codegen <<< "$(measure "$BASELINE")"
+    report "$base_wall" "$base_codegen" "$BASELINE"
+    awk "BEGIN { printf \"  total speedup: %.2fx\\n\", $base_wall / $cur_wall }"
+fi
@@ -0,0 +1,83 @@
+#!/bin/bash
+# Import resolution against a module exporting many functions.
+#
+# Usage: bench/import_resolution.sh [compiler] [baseline-compiler]
+#
+# Generates lib.rac exporting EXPORTS functions (default 10000) and main.rac
+# calling every one of them through `import lib;`. lib is built once per
+# compiler; main is then recompiled RUNS times and the best wall time is
+# reported, along with the imports + codegen time from --stats (compilers
+# that predate the "imports" line report codegen only, which still includes
+# the symbol lookups). Pass a second compiler to compare against it.
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+COMPILER="${1:-$SCRIPT_DIR/../build/raccoonc}"
+BASELINE="$2"
+EXPORTS="${EXPORTS:-10000}"
+RUNS="${RUNS:-5}"
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+generate() {
+    for ((f = 0; f < EXPORTS; f++)); do
+        echo "export fun f$f(a: i32, b: i32): i32 { return a + b + $f; }"
+    done > "$WORK_DIR/lib.rac"
+    {
+        echo "import lib;"
+        echo "fun main(): i32 {"
+        echo "    let s = 0;"
+        for ((f = 0; f < EXPORTS; f++)); do
+            echo "    s = s + lib.f$f(1, 2);"
+        done
+        echo "    return s;"
+        echo "}"
+    } > "$WORK_DIR/main.rac"
+}
+
+# Prints "<best wall ms> <best imports+codegen ms or ->" for recompiling main.
+measure() {
+    local compiler="$1"
+    (cd "$WORK_DIR" && rm -f ./*.o ./*.racm &&
+        "$compiler" -q -f --emit-object main.rac -o main.o >/dev/null)
+    local best_wall=""
+    local best_front="-"
+    for ((i = 0; i < RUNS; i++)); do
+        local start end wall front
+        rm -f "$WORK_DIR/main.o" # lib.o stays, so only main is rebuilt
+        start=$(date +%s%N)
+        front=$(cd "$WORK_DIR" &&
+            "$compiler" --stats --emit-object main.rac -o main.o 2>/dev/null |
+            awk '/main: (imports|codegen)/ { sum += $(NF - 1); n++ }
+                 END { if (n > 0) print sum }')
+        end=$(date +%s%N)
+        wall=$(( (end - start) / 1000000 ))
+        if [ -z "$best_wall" ] || [ "$wall" -lt "$best_wall" ]; then
+            best_wall="$wall"
+        fi
+        if [ -n "$front" ] && { [ "$best_front" = "-" ] ||
+            awk "BEGIN { exit !($front < $best_front) }"; }; then
+            best_front="$front"
+        fi
+    done
+    echo "$best_wall $best_front"
+}
+
+report() {
+    echo "  total ${1} ms, imports+codegen ${2} ms  [$3]"
+}
+
+generate
+echo "Import resolution: main calls $EXPORTS functions exported by lib"
+
+echo "Best of $RUNS runs:"
+read -r cur_wall cur_front <<< "$(measure "$COMPILER")"
+report "$cur_wall" "$cur_front" "$COMPILER"
+
+if [ -n "$BASELINE" ]; then
+    read -r base_wall base_front <<< "$(measure "$BASELINE")"
+    report "$base_wall" "$base_front" "$BASELINE"
+    awk "BEGIN { printf \"  total speedup: %.2fx\\n\", $base_wall / $cur_wall }"
+fi
@@ -0,0 +1,58 @@
+#!/bin/bash
+# Lexer/parser throughput on a multi-megabyte synthetic source file.
+#
+# Usage: bench/lex_throughput.sh [compiler]
+#
+# Generates a file of roughly SIZE_MB megabytes (default 8) and compiles it
+# with --emit-llvm --stats, reporting the tokens/sec line the compiler prints
+# for the parse phase (best of RUNS).
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+COMPILER="${1:-$SCRIPT_DIR/../build/raccoonc}"
+SIZE_MB="${SIZE_MB:-8}"
+RUNS="${RUNS:-3}"
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+SOURCE="$WORK_DIR/large.rac"
+
+generate() {
+    local target=$((SIZE_MB * 1024 * 1024))
+    local f=0
+    local body
+    body=$(for ((s = 0; s < 60; s++)); do
+        echo "    let value_$s: i32 = (a + $s) * b - counter / 3; // note"
+        echo "    if (value_$s >= counter && flag) { counter = counter + 1; }"
+    done)
+    while [ "$(stat -c %s "$SOURCE" 2>/dev/null || echo 0)" -lt "$target" ]; do
+        {
+            for ((i = 0; i < 50; i++, f++)); do
+                echo "fun function_$f(a: i32, b: i32, flag: bool): i32 {"
+                echo "    let counter: i32 = 0;"
+                echo "$body"
+                echo "    return counter;"
+                echo "}"
+            done
+        } >> "$SOURCE"
+    done
+    echo "fun main(): i32 { return 0; }" >> "$SOURCE"
+}
+
+generate
+echo "Source: $(stat -c %s "$SOURCE") bytes"
+
+best=""
+for ((i = 0; i < RUNS; i++)); do
+    line=$("$COMPILER" --emit-llvm --stats "$SOURCE" -o "$WORK_DIR/out.ll" |
+        grep "tokens/sec")
+    rate=$(echo "$line" | sed -n 's/.*(\([0-9]*\) tokens\/sec).*/\1/p')
+    if [ -z "$best" ] || [ "$rate" -gt "$best" ]; then
+        best="$rate"
+        best_line="$line"
+    fi
+done
+
+echo "Best of $RUNS runs:"
+echo "  $best_line"
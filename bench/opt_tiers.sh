@@ -0,0 +1,74 @@
+#!/bin/bash
+# Compile time and runtime of the test corpus at -O0, -Og and -O2.
+#
+# Usage: bench/opt_tiers.sh [compiler]
+#
+# Compiles every tests/single program, plus one loop-heavy program so the
+# runtime column has something to measure, at each level and reports the
+# total compile and run wall times. Compile times cover object files only
+# (no linking) and are the best of RUNS (default 3) passes over the corpus.
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+COMPILER="${1:-$SCRIPT_DIR/../build/raccoonc}"
+RUNS="${RUNS:-3}"
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+cp "$SCRIPT_DIR"/../tests/single/*.rac "$WORK_DIR"/
+cat > "$WORK_DIR/hot_loop.rac" <<RAC
+fun step(acc: i32, i: i32, r: i32): i32 {
+    if (i > r) {
+        return acc + i * 3;
+    }
+    return acc - 1;
+}
+
+fun main(): i32 {
+    let total = 0;
+    for (let r = 0; r < 20000; r = r + 1) {
+        let acc = 0;
+        for (let i = 0; i < 10000; i = i + 1) {
+            acc = step(acc, i, r);
+        }
+        total = total + acc;
+    }
+    return total % 256;
+}
+RAC
+
+# Prints "<best compile ms> <run ms>" for one optimization flag.
+measure() {
+    local flag="$1" start end wall best="" run=0
+    for ((i = 0; i < RUNS; i++)); do
+        start=$(date +%s%N)
+        for src in "$WORK_DIR"/*.rac; do
+            "$COMPILER" -q -f "$flag" --emit-object "$src"
+        done
+        end=$(date +%s%N)
+        wall=$(( (end - start) / 1000000 ))
+        if [ -z "$best" ] || [ "$wall" -lt "$best" ]; then
+            best="$wall"
+        fi
+    done
+
+    for src in "$WORK_DIR"/*.rac; do
+        "$COMPILER" -q -f "$flag" "$src" -o "${src%.rac}.$flag"
+    done
+    start=$(date +%s%N)
+    for src in "$WORK_DIR"/*.rac; do
+        "${src%.rac}.$flag" || true # exit codes are the tests' results
+    done
+    end=$(date +%s%N)
+    run=$(( (end - start) / 1000000 ))
+    echo "$best $run"
+}
+
+cd "$WORK_DIR"
+echo "$(ls "$WORK_DIR"/*.rac | wc -l) programs; best of $RUNS compiles"
+for flag in -O0 -Og -O2; do
+    read -r compile run <<< "$(measure "$flag")"
+    printf "  %-4s compile %6s ms   run %6s ms\n" "$flag" "$compile" "$run"
+done
@@ -0,0 +1,67 @@
+#!/bin/bash
+# Per-file compile latency: a fresh raccoonc process versus raccoonc-client
+# talking to a warm `raccoonc --server`.
+#
+# Usage: bench/server_latency.sh [compiler]
+#
+# raccoonc-client is expected next to the compiler. Generates FILES small
+# independent modules (default 50) and compiles each one to an object file
+# with -f, once per process and once through the server, reporting the mean
+# wall time per file for both.
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+COMPILER="${1:-$SCRIPT_DIR/../build/raccoonc}"
+CLIENT="$(dirname "$COMPILER")/raccoonc-client"
+FILES="${FILES:-50}"
+
+WORK_DIR="$(mktemp -d)"
+export RACCOONC_SOCKET="$WORK_DIR/raccoonc.sock"
+SERVER_PID=""
+cleanup() {
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null || true
+    rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+generate() {
+    for ((f = 0; f < FILES; f++)); do
+        {
+            echo "fun helper(a: i32, b: i32): i32 {"
+            echo "    let s = 0;"
+            echo "    for (let i = 0; i < a; i = i + 1) { s = s + i * b; }"
+            echo "    return s;"
+            echo "}"
+            echo "fun main(): i32 { return helper(10, $f); }"
+        } > "$WORK_DIR/f$f.rac"
+    done
+}
+
+# Prints the mean wall time in ms per file when compiling with $1.
+measure() {
+    local start end
+    start=$(date +%s%N)
+    for ((f = 0; f < FILES; f++)); do
+        (cd "$WORK_DIR" && "$1" -q -f --emit-object "f$f.rac" -o "f$f.o")
+    done
+    end=$(date +%s%N)
+    awk "BEGIN { printf \"%.2f\", ($end - $start) / 1000000 / $FILES }"
+}
+
+generate
+echo "Server latency: $FILES single-file compiles"
+
+cold=$(measure "$COMPILER")
+echo "  cold (new process each): $cold ms/file"
+
+"$COMPILER" --server > "$WORK_DIR/server.log" 2>&1 &
+SERVER_PID=$!
+for ((i = 0; i < 50; i++)); do
+    [ -S "$RACCOONC_SOCKET" ] && break
+    sleep 0.1
+done
+
+warm=$(measure "$CLIENT")
+echo "  warm (client + server):  $warm ms/file"
+awk "BEGIN { printf \"  speedup: %.2fx\\n\", $cold / $warm }"
@@ -1,160 +1,306 @@
 #pragma once
 
-#include <string>
+#include <string_view>
 #include <utility>
-#include <vector>
 
+#include <llvm/Support/Casting.h>
+
+#include "Arena.hpp"
+#include "Symbol.hpp"
 #include "Token.hpp"
+#include "Type.hpp"
+
+// AST nodes are allocated in the owning CompilationUnit's Arena and are never
+// deleted one by one, so they only hold arena-backed storage: identifiers are
+// interned Symbols, types are uniqued Types from the unit's TypeContext and
+// child lists are ArenaVectors.
+//
+// Every node records its concrete type in a kind tag instead of relying on
+// RTTI. Each node class provides classof() so llvm::isa/cast/dyn_cast work on
+// it, and ASTVisitor.hpp switches on the tag to dispatch whole trees.
+
+enum class ExprKind {
+  IntLiteral,
+  FloatLiteral,
+  BoolLiteral,
+  StrLiteral,
+  CharLiteral,
+  StructLiteral,
+  UnaryExpr,
+  Variable,
+  BinaryExpr,
+  CallExpr,
+  MemberAccessExpr,
+};
+
+enum class StmtKind {
+  VarDecl,
+  FunctionDecl,
+  StructDecl,
+  ImportDecl,
+  ExprStmt,
+  IfStmt,
+  WhileStmt,
+  ForStmt,
+  ReturnStmt,
+  BlockStmt,
+};
 
 struct Expr {
-  virtual ~Expr() = default;
+  const ExprKind kind;
+
+protected:
+  explicit Expr(ExprKind k) : kind(k) {}
 };
 
 struct IntLiteral : Expr {
   long long value;
-  IntLiteral(long long v) : value(v) {}
+  IntLiteral(long long v) : Expr(ExprKind::IntLiteral), value(v) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::IntLiteral;
+  }
 };
 
 struct FloatLiteral : Expr {
   float value;
-  FloatLiteral(float v) : value(v) {}
+  FloatLiteral(float v) : Expr(ExprKind::FloatLiteral), value(v) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::FloatLiteral;
+  }
 };
 
 struct BoolLiteral : Expr {
   bool value;
-  BoolLiteral(bool v) : value(v) {}
+  BoolLiteral(bool v) : Expr(ExprKind::BoolLiteral), value(v) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::BoolLiteral;
+  }
 };
 
 struct StrLiteral : Expr {
-  std::string value;
-  StrLiteral(std::string v) : value(v) {}
+  std::string_view value;
+  StrLiteral(std::string_view v) : Expr(ExprKind::StrLiteral), value(v) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::StrLiteral;
+  }
 };
 
 struct CharLiteral : Expr {
   char value;
-  CharLiteral(char v) : value(v) {}
+  CharLiteral(char v) : Expr(ExprKind::CharLiteral), value(v) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::CharLiteral;
+  }
 };
 
 struct StructLiteral : Expr {
-  std::string typeName;
-  std::vector<std::pair<std::string, Expr *>> fields; // field name + value
-  std::string moduleName;
-  StructLiteral(std::string t, std::vector<std::pair<std::string, Expr *>> f,
-                std::string m = "")
-      : typeName(t), fields(f), moduleName(m) {}
+  Symbol typeName;
+  ArenaVector<std::pair<Symbol, Expr *>> fields; // field name + value
+  Symbol moduleName;
+  StructLiteral(Symbol t, ArenaVector<std::pair<Symbol, Expr *>> f,
+                Symbol m = Symbol())
+      : Expr(ExprKind::StructLiteral), typeName(t), fields(std::move(f)),
+        moduleName(m) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::StructLiteral;
+  }
 };
 
 struct UnaryExpr : Expr {
   TokenType op;
   Expr *operand;
-  UnaryExpr(TokenType op, Expr *o) : op(op), operand(o) {}
+  UnaryExpr(TokenType op, Expr *o)
+      : Expr(ExprKind::UnaryExpr), op(op), operand(o) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::UnaryExpr;
+  }
 };
 
 struct Variable : Expr {
-  std::string name;
-  Variable(std::string v) : name(v) {}
+  Symbol name;
+  Variable(Symbol v) : Expr(ExprKind::Variable), name(v) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::Variable;
+  }
 };
 
 struct BinaryExpr : Expr {
   Expr *left;
   Expr *right;
   TokenType op;
-  BinaryExpr(Expr *l, Expr *r, TokenType o) : left(l), right(r), op(o) {}
+  BinaryExpr(Expr *l, Expr *r, TokenType o)
+      : Expr(ExprKind::BinaryExpr), left(l), right(r), op(o) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::BinaryExpr;
+  }
 };
 
 struct CallExpr : Expr {
-  std::string name;
-  std::vector<Expr *> args;
-  std::string type;
-  std::string moduleName;
-  CallExpr(std::string n, std::vector<Expr *> a, std::string t,
-           std::string m = "")
-      : name(n), args(a), type(t), moduleName(m) {}
+  Symbol name;
+  ArenaVector<Expr *> args;
+  const Type *type; // malloc<T> type argument, nullptr for other calls
+  Symbol moduleName;
+  CallExpr(Symbol n, ArenaVector<Expr *> a, const Type *t, Symbol m = Symbol())
+      : Expr(ExprKind::CallExpr), name(n), args(std::move(a)), type(t),
+        moduleName(m) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::CallExpr;
+  }
 };
 
 struct MemberAccessExpr : Expr {
   Expr *object;
-  std::string field;
-  MemberAccessExpr(Expr *obj, std::string f) : object(obj), field(f) {}
+  Symbol field;
+  MemberAccessExpr(Expr *obj, Symbol f)
+      : Expr(ExprKind::MemberAccessExpr), object(obj), field(f) {}
+
+  static bool classof(const Expr *node) {
+    return node->kind == ExprKind::MemberAccessExpr;
+  }
 };
 
 struct Statement {
-  virtual ~Statement() = default;
+  const StmtKind kind;
+
+protected:
+  explicit Statement(StmtKind k) : kind(k) {}
 };
 
 struct VarDecl : Statement {
-  std::string name;
-  std::string type;
+  Symbol name;
+  const Type *type;
   Expr *initializer;
   bool isConst;
-  VarDecl(std::string n, std::string t, Expr *i, bool isC)
-      : name(n), type(t), initializer(i), isConst(isC) {}
+  VarDecl(Symbol n, const Type *t, Expr *i, bool isC)
+      : Statement(StmtKind::VarDecl), name(n), type(t), initializer(i),
+        isConst(isC) {}
+
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::VarDecl;
+  }
 };
 
 struct FunctionDecl : Statement {
-  std::string name;
-  std::vector<std::pair<std::string, std::string>> params; // name + type
-  std::vector<Statement *> body;
-  std::string returnType;
+  Symbol name;
+  ArenaVector<std::pair<Symbol, const Type *>> params; // name + type
+  ArenaVector<Statement *> body;
+  const Type *returnType;
   bool isExported;
   bool isExternal;
+  // Targets from @target_clones("avx2", ..., "default"); empty otherwise.
+  ArenaVector<std::string_view> targetClones;
+  // Indices of the params declared `restrict`, in order.
+  ArenaVector<unsigned> restrictParams;
+
+  FunctionDecl(Symbol n, ArenaVector<std::pair<Symbol, const Type *>> p,
+               ArenaVector<Statement *> b, const Type *r,
+               bool exported = false, bool ext = false)
+      : Statement(StmtKind::FunctionDecl), name(n), params(std::move(p)),
+        body(std::move(b)), returnType(r), isExported(exported),
+        isExternal(ext), targetClones(params.get_allocator()),
+        restrictParams(params.get_allocator()) {}
 
-  FunctionDecl(std::string n,
-               std::vector<std::pair<std::string, std::string>> p,
-               std::vector<Statement *> b, std::string r, bool exported = false,
-               bool ext = false)
-      : name(n), params(p), body(b), returnType(r), isExported(exported),
-        isExternal(ext) {}
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::FunctionDecl;
+  }
 };
 
 struct StructDecl : Statement {
-  std::string name;
-  std::vector<std::pair<std::string, std::string>> fields; // name + type
+  Symbol name;
+  ArenaVector<std::pair<Symbol, const Type *>> fields; // name + type
   bool isExported;
-  StructDecl(std::string n, std::vector<std::pair<std::string, std::string>> f,
+  StructDecl(Symbol n, ArenaVector<std::pair<Symbol, const Type *>> f,
              bool exported = false)
-      : name(n), fields(f), isExported(exported) {}
+      : Statement(StmtKind::StructDecl), name(n), fields(std::move(f)),
+        isExported(exported) {}
+
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::StructDecl;
+  }
 };
 
 struct ImportDecl : Statement {
-  std::string modulePath;
-  ImportDecl(std::string p) : modulePath(p) {}
+  std::string_view modulePath;
+  ImportDecl(std::string_view p)
+      : Statement(StmtKind::ImportDecl), modulePath(p) {}
+
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::ImportDecl;
+  }
 };
 
 struct ExprStmt : Statement {
   Expr *expr;
-  ExprStmt(Expr *e) : expr(e) {}
+  ExprStmt(Expr *e) : Statement(StmtKind::ExprStmt), expr(e) {}
+
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::ExprStmt;
+  }
 };
 
 struct IfStmt : Statement {
   Expr *condition;
-  std::vector<Statement *> thenBranch;
-  std::vector<Statement *> elseBranch; // optional
-  IfStmt(Expr *c, std::vector<Statement *> t, std::vector<Statement *> e = {})
-      : condition(c), thenBranch(t), elseBranch(e) {}
+  ArenaVector<Statement *> thenBranch;
+  ArenaVector<Statement *> elseBranch; // empty without an else
+  IfStmt(Expr *c, ArenaVector<Statement *> t, ArenaVector<Statement *> e)
+      : Statement(StmtKind::IfStmt), condition(c), thenBranch(std::move(t)),
+        elseBranch(std::move(e)) {}
+
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::IfStmt;
+  }
 };
 
 struct WhileStmt : Statement {
   Expr *condition;
-  std::vector<Statement *> body;
-  WhileStmt(Expr *c, std::vector<Statement *> b) : condition(c), body(b) {}
+  ArenaVector<Statement *> body;
+  WhileStmt(Expr *c, ArenaVector<Statement *> b)
+      : Statement(StmtKind::WhileStmt), condition(c), body(std::move(b)) {}
+
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::WhileStmt;
+  }
 };
 
 struct ForStmt : Statement {
   Statement *initializer; // usually VarDecl or ExprStmt
   Expr *condition;
   Expr *increment;
-  std::vector<Statement *> body;
-  ForStmt(Statement *i, Expr *c, Expr *inc, std::vector<Statement *> b)
-      : initializer(i), condition(c), increment(inc), body(b) {}
+  ArenaVector<Statement *> body;
+  ForStmt(Statement *i, Expr *c, Expr *inc, ArenaVector<Statement *> b)
+      : Statement(StmtKind::ForStmt), initializer(i), condition(c),
+        increment(inc), body(std::move(b)) {}
+
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::ForStmt;
+  }
 };
 
 struct ReturnStmt : Statement {
   Expr *value; // nullptr if no return expression
-  ReturnStmt(Expr *v = nullptr) : value(v) {}
+  ReturnStmt(Expr *v = nullptr) : Statement(StmtKind::ReturnStmt), value(v) {}
+
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::ReturnStmt;
+  }
 };
 
 struct BlockStmt : Statement {
-  std::vector<Statement *> statements;
-  BlockStmt(std::vector<Statement *> s) : statements(s) {}
+  ArenaVector<Statement *> statements;
+  BlockStmt(ArenaVector<Statement *> s)
+      : Statement(StmtKind::BlockStmt), statements(std::move(s)) {}
+
+  static bool classof(const Statement *node) {
+    return node->kind == StmtKind::BlockStmt;
+  }
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AST.hpp"
+#include "ASTVisitor.hpp"
 
 void printStatement(Statement *stmt, int indent = 0);
 void printExpr(Expr *expr, int indent = 0);
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "AST.hpp"
+
+/// Switch-based visitors over the AST kind tags.
+///
+/// Derived classes inherit from ExprVisitor<Derived, RetTy> and/or
+/// StmtVisitor<Derived, RetTy> (CRTP) and define visitXxx(Xxx *) for the nodes
+/// they care about. visitExpr()/visitStmt() dispatch with a single switch on
+/// the node's kind. Nodes without a handler in the derived class fall through
+/// to unhandledExpr()/unhandledStmt(), which return a default-constructed
+/// RetTy unless the derived class overrides them too.
+
+template <typename Derived, typename RetTy = void> class ExprVisitor {
+public:
+  RetTy visitExpr(Expr *expr) {
+    Derived *self = static_cast<Derived *>(this);
+    switch (expr->kind) {
+    case ExprKind::IntLiteral:
+      return self->visitIntLiteral(static_cast<IntLiteral *>(expr));
+    case ExprKind::FloatLiteral:
+      return self->visitFloatLiteral(static_cast<FloatLiteral *>(expr));
+    case ExprKind::BoolLiteral:
+      return self->visitBoolLiteral(static_cast<BoolLiteral *>(expr));
+    case ExprKind::StrLiteral:
+      return self->visitStrLiteral(static_cast<StrLiteral *>(expr));
+    case ExprKind::CharLiteral:
+      return self->visitCharLiteral(static_cast<CharLiteral *>(expr));
+    case ExprKind::StructLiteral:
+      return self->visitStructLiteral(static_cast<StructLiteral *>(expr));
+    case ExprKind::UnaryExpr:
+      return self->visitUnaryExpr(static_cast<UnaryExpr *>(expr));
+    case ExprKind::Variable:
+      return self->visitVariable(static_cast<Variable *>(expr));
+    case ExprKind::BinaryExpr:
+      return self->visitBinaryExpr(static_cast<BinaryExpr *>(expr));
+    case ExprKind::CallExpr:
+      return self->visitCallExpr(static_cast<CallExpr *>(expr));
+    case ExprKind::MemberAccessExpr:
+      return self->visitMemberAccessExpr(static_cast<MemberAccessExpr *>(expr));
+    }
+    return self->unhandledExpr(expr);
+  }
+
+  RetTy unhandledExpr(Expr *) { return RetTy(); }
+
+  RetTy visitIntLiteral(IntLiteral *e) { return unhandled(e); }
+  RetTy visitFloatLiteral(FloatLiteral *e) { return unhandled(e); }
+  RetTy visitBoolLiteral(BoolLiteral *e) { return unhandled(e); }
+  RetTy visitStrLiteral(StrLiteral *e) { return unhandled(e); }
+  RetTy visitCharLiteral(CharLiteral *e) { return unhandled(e); }
+  RetTy visitStructLiteral(StructLiteral *e) { return unhandled(e); }
+  RetTy visitUnaryExpr(UnaryExpr *e) { return unhandled(e); }
+  RetTy visitVariable(Variable *e) { return unhandled(e); }
+  RetTy visitBinaryExpr(BinaryExpr *e) { return unhandled(e); }
+  RetTy visitCallExpr(CallExpr *e) { return unhandled(e); }
+  RetTy visitMemberAccessExpr(MemberAccessExpr *e) { return unhandled(e); }
+
+private:
+  RetTy unhandled(Expr *expr) {
+    return static_cast<Derived *>(this)->unhandledExpr(expr);
+  }
+};
+
+template <typename Derived, typename RetTy = void> class StmtVisitor {
+public:
+  RetTy visitStmt(Statement *stmt) {
+    Derived *self = static_cast<Derived *>(this);
+    switch (stmt->kind) {
+    case StmtKind::VarDecl:
+      return self->visitVarDecl(static_cast<VarDecl *>(stmt));
+    case StmtKind::FunctionDecl:
+      return self->visitFunctionDecl(static_cast<FunctionDecl *>(stmt));
+    case StmtKind::StructDecl:
+      return self->visitStructDecl(static_cast<StructDecl *>(stmt));
+    case StmtKind::ImportDecl:
+      return self->visitImportDecl(static_cast<ImportDecl *>(stmt));
+    case StmtKind::ExprStmt:
+      return self->visitExprStmt(static_cast<ExprStmt *>(stmt));
+    case StmtKind::IfStmt:
+      return self->visitIfStmt(static_cast<IfStmt *>(stmt));
+    case StmtKind::WhileStmt:
+      return self->visitWhileStmt(static_cast<WhileStmt *>(stmt));
+    case StmtKind::ForStmt:
+      return self->visitForStmt(static_cast<ForStmt *>(stmt));
+    case StmtKind::ReturnStmt:
+      return self->visitReturnStmt(static_cast<ReturnStmt *>(stmt));
+    case StmtKind::BlockStmt:
+      return self->visitBlockStmt(static_cast<BlockStmt *>(stmt));
+    }
+    return self->unhandledStmt(stmt);
+  }
+
+  RetTy unhandledStmt(Statement *) { return RetTy(); }
+
+  RetTy visitVarDecl(VarDecl *s) { return unhandled(s); }
+  RetTy visitFunctionDecl(FunctionDecl *s) { return unhandled(s); }
+  RetTy visitStructDecl(StructDecl *s) { return unhandled(s); }
+  RetTy visitImportDecl(ImportDecl *s) { return unhandled(s); }
+  RetTy visitExprStmt(ExprStmt *s) { return unhandled(s); }
+  RetTy visitIfStmt(IfStmt *s) { return unhandled(s); }
+  RetTy visitWhileStmt(WhileStmt *s) { return unhandled(s); }
+  RetTy visitForStmt(ForStmt *s) { return unhandled(s); }
+  RetTy visitReturnStmt(ReturnStmt *s) { return unhandled(s); }
+  RetTy visitBlockStmt(BlockStmt *s) { return unhandled(s); }
+
+private:
+  RetTy unhandled(Statement *stmt) {
+    return static_cast<Derived *>(this)->unhandledStmt(stmt);
+  }
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Vector whose storage lives in an Arena. AST nodes use these for child lists
+/// so that nothing owned by a node ever touches the global heap.
+template <typename T> using ArenaVector = std::pmr::vector<T>;
+
+/// Bump allocator owned by a CompilationUnit.
+///
+/// Every AST node is placed into the arena and is never destroyed
+/// individually: destructors are not run, and the whole tree is released at
+/// once by freeing the arena's chunks. This only works because nodes keep all
+/// of their storage in the same arena (ArenaVector, copyString), so do not put
+/// owning std::string/std::vector members into arena-allocated types.
+class Arena : public std::pmr::memory_resource {
+public:
+  static constexpr size_t DefaultChunkSize = 64 * 1024;
+
+  explicit Arena(size_t chunkSize = DefaultChunkSize) : chunkSize(chunkSize) {}
+  ~Arena() override { this->release(); }
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    void *mem = this->allocate(sizeof(T), alignof(T));
+    return new (mem) T(std::forward<Args>(args)...);
+  }
+
+  template <typename T> ArenaVector<T> makeVector() {
+    return ArenaVector<T>(this);
+  }
+
+  /// Copy a string into the arena. The returned view lives as long as the
+  /// arena does.
+  std::string_view copyString(std::string_view str);
+
+  /// Free every chunk at once. Objects placed in the arena must not be used
+  /// afterwards.
+  void release();
+
+  size_t bytesUsed() const { return this->used; }
+  size_t bytesReserved() const { return this->reserved; }
+  size_t chunkCount() const { return this->chunks; }
+
+private:
+  struct Chunk {
+    Chunk *next;
+    size_t size;
+  };
+
+  size_t chunkSize;
+  Chunk *head = nullptr;
+  char *cur = nullptr;
+  char *end = nullptr;
+  size_t used = 0;
+  size_t reserved = 0;
+  size_t chunks = 0;
+
+  void *allocateSlow(size_t bytes, size_t alignment);
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *, size_t, size_t) override {
+    // Individual frees are no-ops; memory comes back in release().
+  }
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// The inputs an object file was built from, by content hash, and the
+/// fingerprint of the interface the build produced.
+struct UnitInputs {
+  uint64_t frontend = 0; // compiler version and anything else shaping the IR
+  uint64_t config = 0;   // code generation options
+  uint64_t source = 0;
+  std::vector<std::pair<std::string, uint64_t>> imports; // module, interface
+  uint64_t interface = 0; // ModuleMetadata::fingerprint(), 0 if no exports
+
+  bool operator==(const UnitInputs &) const = default;
+};
+
+/// The build-state file: for every object file the driver has produced, the
+/// inputs it was built from. A unit is rebuilt only when one of them changes,
+/// so touching a file without editing it rebuilds nothing, while a changed
+/// interface rebuilds every module that imports it.
+class BuildState {
+public:
+  /// Load the state saved at `filepath`. A missing or malformed file leaves
+  /// the state empty, which just means everything is rebuilt.
+  void load(const std::string &filepath);
+  bool save(const std::string &filepath) const;
+
+  /// The recorded inputs of `objectFile`, or nullptr if it was never built.
+  const UnitInputs *find(const std::string &objectFile) const;
+  void record(const std::string &objectFile, UnitInputs inputs);
+
+  static uint64_t hash(std::string_view data);
+
+private:
+  std::map<std::string, UnitInputs> units;
+};
@@ -2,27 +2,43 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Value.h>
+#include <llvm/IR/ValueHandle.h>
 
 #include "AST.hpp"
+#include "ASTVisitor.hpp"
 #include "ModuleMetadata.hpp"
+#include "Symbol.hpp"
+#include "Type.hpp"
 
 struct LocalVar {
-  llvm::AllocaInst *alloca;
+  static constexpr uint32_t NotSSA = ~0u;
+
+  llvm::AllocaInst *alloca; // nullptr for globals and SSA locals
   llvm::Type *type;
-  std::string typeStr;
+  const Type *sourceType;
   bool isConst;
+  uint32_t ssaVar = NotSSA; // index into Codegen::ssaVariables
+
+  bool isSSA() const { return this->ssaVar != NotSSA; }
 };
 
-class Codegen {
+class Codegen : private ExprVisitor<Codegen, llvm::Value *>,
+                private StmtVisitor<Codegen> {
+  friend class ExprVisitor<Codegen, llvm::Value *>;
+  friend class StmtVisitor<Codegen>;
+
 public:
-  Codegen(const std::string &moduleName);
+  Codegen(const std::string &moduleName, TypeContext &types);
   ~Codegen();
 
   void generate(const std::vector<Statement *> &statements);
@@ -34,87 +50,156 @@ public:
 
   void loadImport(const std::string &modulePath, const std::string &baseDir);
 
+  /// Add the parameter attributes that depend on the target: struct pointer
+  /// params are dereferenceable for, and aligned to, their struct. Codegen's
+  /// IR is target-neutral, so it only records which params those are. Call
+  /// once the module has its DataLayout.
+  static void addTargetAttributes(llvm::Module &module);
+
 private:
   llvm::LLVMContext context;
   std::unique_ptr<llvm::Module> module;
   std::unique_ptr<llvm::IRBuilder<>> builder;
-  std::vector<std::unordered_map<std::string, LocalVar>> scopeStack;
-  std::unordered_map<std::string, llvm::StructType *> structTypes;
-  std::unordered_map<std::string,
-                     std::vector<std::pair<std::string, std::string>>>
+  TypeContext &types; // the unit's types; also used for imported spellings
+  // All name-keyed tables use interned Symbols; struct tables are keyed by the
+  // mangled (module_Type) symbol.
+
+  // Lexical scopes as one flat table. `bindings` is a stack of every variable
+  // in scope, `innermost` maps a name to its innermost binding, and each
+  // binding links to the one it shadows. pushScope() records a mark in
+  // `scopeMarks`; popScope() unwinds back to it. LocalVar pointers handed out
+  // by findVariable() are only valid until the next addVariable().
+  struct Binding {
+    Symbol name;
+    uint32_t shadowed; // index into bindings, or NoBinding
+    LocalVar var;
+  };
+  static constexpr uint32_t NoBinding = ~0u;
+  std::vector<Binding> bindings;
+  std::vector<uint32_t> scopeMarks;
+  llvm::DenseMap<Symbol, uint32_t> innermost;
+  llvm::DenseMap<Symbol, llvm::StructType *> structTypes;
+  llvm::DenseMap<Symbol, std::vector<std::pair<Symbol, const Type *>>>
       structFieldMetadata;
-  std::string currentModuleName;
+  Symbol currentModuleName;
   ModuleMetadata currentModuleExports;
-  std::unordered_map<std::string, ModuleMetadata> importedModules;
-
-  static std::string getPointedToType(const std::string &ptrType) {
-    if (ptrType.empty() || ptrType.back() != '*') {
-      return "";
-    }
-    return ptrType.substr(0, ptrType.size() - 1);
-  }
-
-  llvm::Type *getLLVMType(const std::string &type, llvm::LLVMContext &ctx);
+  llvm::DenseMap<Symbol, std::shared_ptr<const ModuleInterface>>
+      importedModules;
+  // Function metadata listing the struct pointer params, as (index, constant
+  // of the struct type) pairs, for addTargetAttributes.
+  static constexpr const char *StructParamsMetadata = "raccoon.struct_params";
+
+  // SSA construction for the function being generated, after Braun et al.,
+  // "Simple and Efficient Construction of Static Single Assignment Form".
+  // Scalar locals whose address is never taken get no alloca: assignments
+  // record the variable's value for the current block and reads look it up,
+  // walking to predecessors and placing phis where values meet. A block is
+  // sealed once all its predecessors are known; until then reads in it get
+  // an empty phi that sealBlock() fills in (loop headers).
+  struct SSAVariable {
+    Symbol name;
+    llvm::Type *type;
+    // Tracking handles, so defs follow phis that get folded away.
+    llvm::DenseMap<llvm::BasicBlock *, llvm::WeakTrackingVH> defs;
+  };
+  std::vector<SSAVariable> ssaVariables;
+  llvm::DenseSet<llvm::BasicBlock *> sealedBlocks;
+  llvm::DenseMap<llvm::BasicBlock *,
+                 std::vector<std::pair<uint32_t, llvm::PHINode *>>>
+      incompletePhis;
+  // Names used as `&name` in the current function; those locals keep an
+  // alloca.
+  llvm::DenseSet<Symbol> addressTaken;
+
+  /// Lower a type, caching the result on the Type once it is fully resolved.
+  llvm::Type *getLLVMType(const Type *type);
+
+  /// Key into structTypes for a struct type: "module.Type" and local structs
+  /// of the current module resolve to their mangled names.
+  Symbol resolveStructName(const Type *type);
+
+  /// Parse a type spelling from an imported module's interface. Bare struct
+  /// names the module exports are qualified with the module's name.
+  const Type *importType(std::string_view spelling,
+                         const ModuleInterface &iface);
 
   /// helper: cast integer values between widths (signed extend / trunc)
   static llvm::Value *castIntegerIfNeeded(llvm::IRBuilder<> *builder,
                                           llvm::Value *val, llvm::Type *fromTy,
                                           llvm::Type *toTy);
 
-  /// helper: check if a type string represents an unsigned type
-  static bool isUnsignedType(const std::string &typeStr) {
-    return !typeStr.empty() && typeStr[0] == 'u';
-  }
-
-  std::string getExprTypeStr(Expr *expr) {
-    if (auto *var = dynamic_cast<Variable *>(expr)) {
-      LocalVar *localVar = this->findVariable(var->name);
-      return localVar->typeStr;
-    }
-
-    if (dynamic_cast<IntLiteral *>(expr)) {
-      return "i32";
-    }
-    if (dynamic_cast<FloatLiteral *>(expr)) {
-      return "f32";
+  const Type *getExprType(Expr *expr) {
+    switch (expr->kind) {
+    case ExprKind::Variable:
+      return this->findVariable(static_cast<Variable *>(expr)->name)
+          ->sourceType;
+    case ExprKind::IntLiteral:
+      return this->types.getI32();
+    case ExprKind::FloatLiteral:
+      return this->types.getF32();
+    case ExprKind::BoolLiteral:
+      return this->types.getBool();
+    case ExprKind::CharLiteral:
+      return this->types.getChar();
+    default:
+      // For more complex expressions, we can't easily determine type without
+      // full type inference Default to signed for now...
+      return this->types.getI32();
     }
-    if (dynamic_cast<BoolLiteral *>(expr)) {
-      return "bool";
-    }
-    if (dynamic_cast<CharLiteral *>(expr)) {
-      return "char";
-    }
-    // For more complex expressions, we can't easily determine type without full
-    // type inference Default to signed for now...
-    return "i32";
   }
 
   /// find l-value storage for a variable name (local alloca or global variable)
   [[deprecated("Use Codegen::findVariable(name) instead.")]]
   static llvm::Value *
   findLValueStorage(llvm::Module *module,
-                    std::unordered_map<std::string, LocalVar> &locals,
-                    const std::string &name);
+                    llvm::DenseMap<Symbol, LocalVar> &locals, Symbol name);
 
   /// helper: Get field index by name for a struct type
-  int getFieldIndex(const std::string &structName,
-                    const std::string &fieldName);
+  int getFieldIndex(Symbol structName, Symbol fieldName);
+
+  // SSA locals
+  bool canBeSSA(Symbol name, const Type *type) const {
+    return !type->isStruct() && !this->addressTaken.count(name);
+  }
+  uint32_t declareSSAVariable(Symbol name, llvm::Type *type);
+  void writeVariable(uint32_t var, llvm::BasicBlock *block, llvm::Value *value);
+  llvm::Value *readVariable(uint32_t var, llvm::BasicBlock *block);
+  llvm::Value *readVariableRecursive(uint32_t var, llvm::BasicBlock *block);
+  llvm::Value *addPhiOperands(uint32_t var, llvm::PHINode *phi);
+  llvm::Value *tryRemoveTrivialPhi(llvm::PHINode *phi);
+  void sealBlock(llvm::BasicBlock *block);
+  /// The current value of a local: its SSA value or a load of its alloca.
+  llvm::Value *readLocal(const LocalVar &var, const llvm::Twine &name);
+  /// Convert a value being stored into a variable of type `type`.
+  llvm::Value *convertForStore(llvm::Value *value, llvm::Type *type);
 
   // Scope management
   void pushScope();
   void popScope();
-  LocalVar *findVariable(const std::string &name);
-  void addVariable(const std::string &name, const LocalVar &var);
+  LocalVar *findVariable(Symbol name);
+  void addVariable(Symbol name, const LocalVar &var);
 
   llvm::Value *genExpr(Expr *expr);
   llvm::Value *genBinaryExpr(BinaryExpr *expr);
   llvm::Value *genCallExpr(CallExpr *expr);
-  llvm::Value *genStringLiteral(const std::string &str);
+  llvm::Value *genStringLiteral(std::string_view str);
   llvm::Value *genCharLiteral(char c);
   llvm::Value *genUnaryExpr(UnaryExpr *expr);
   llvm::Value *genLValue(Expr *expr);
   llvm::Value *genExprLValue(Expr *expr);
   llvm::Function *genFunction(FunctionDecl *funcDecl);
+  /// Attributes of every Raccoon function, defined or imported: nounwind,
+  /// noundef on scalar params, and nonnull on struct pointer params.
+  void addFunctionAttributes(llvm::Function *function,
+                             llvm::ArrayRef<const Type *> paramTypes);
+  void genFunctionBody(FunctionDecl *funcDecl, llvm::Function *function);
+  /// Emit a @target_clones function: one internal clone per target, and an
+  /// ifunc under the function's own name whose resolver picks a clone from
+  /// the CPU model at load time. Returns the "default" clone.
+  llvm::Function *genTargetClones(FunctionDecl *funcDecl,
+                                  llvm::FunctionType *funcType,
+                                  Symbol functionName,
+                                  llvm::ArrayRef<const Type *> paramTypes);
   void genVarDecl(VarDecl *varDecl);
   void genReturnStatement(ReturnStmt *stmt);
   void genStatement(Statement *stmt);
@@ -129,4 +214,41 @@ private:
   void genStructDecl(StructDecl *structDecl);
   llvm::Value *genStructLiteral(StructLiteral *expr);
   llvm::Value *genMemberAccessExpr(MemberAccessExpr *expr);
+
+  // Visitor hooks; genExpr/genStatement dispatch here on the node kind.
+  llvm::Value *visitIntLiteral(IntLiteral *expr);
+  llvm::Value *visitFloatLiteral(FloatLiteral *expr);
+  llvm::Value *visitBoolLiteral(BoolLiteral *expr);
+  llvm::Value *visitVariable(Variable *var);
+  llvm::Value *visitStrLiteral(StrLiteral *expr) {
+    return this->genStringLiteral(expr->value);
+  }
+  llvm::Value *visitCharLiteral(CharLiteral *expr) {
+    return this->genCharLiteral(expr->value);
+  }
+  llvm::Value *visitStructLiteral(StructLiteral *expr) {
+    return this->genStructLiteral(expr);
+  }
+  llvm::Value *visitUnaryExpr(UnaryExpr *expr) {
+    return this->genUnaryExpr(expr);
+  }
+  llvm::Value *visitBinaryExpr(BinaryExpr *expr) {
+    return this->genBinaryExpr(expr);
+  }
+  llvm::Value *visitCallExpr(CallExpr *expr) { return this->genCallExpr(expr); }
+  llvm::Value *visitMemberAccessExpr(MemberAccessExpr *expr) {
+    return this->genMemberAccessExpr(expr);
+  }
+
+  void visitVarDecl(VarDecl *stmt) { this->genVarDecl(stmt); }
+  void visitFunctionDecl(FunctionDecl *stmt) { this->genFunction(stmt); }
+  void visitStructDecl(StructDecl *stmt) { this->genStructDecl(stmt); }
+  void visitReturnStmt(ReturnStmt *stmt) { this->genReturnStatement(stmt); }
+  void visitExprStmt(ExprStmt *stmt) { this->genExpr(stmt->expr); }
+  void visitIfStmt(IfStmt *stmt) { this->genIfStatement(stmt); }
+  void visitWhileStmt(WhileStmt *stmt) { this->genWhileStatement(stmt); }
+  void visitForStmt(ForStmt *stmt) { this->genForStatement(stmt); }
+  void visitBlockStmt(BlockStmt *stmt) { this->genBlockStatement(stmt); }
+  // Imports are resolved by the driver before codegen runs.
+  void visitImportDecl(ImportDecl *) {}
 };
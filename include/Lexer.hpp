@@ -1,28 +1,44 @@
 #pragma once
 
 #include "Token.hpp"
-#include <string>
+#include <string_view>
 
+/// Tokens returned by the lexer point into `source`, so the buffer must
+/// outlive every token (and every AST node built from one).
+///
+/// Peeked tokens are kept in a small ring buffer and handed out by the
+/// following nextToken() calls, so each character is lexed exactly once no
+/// matter how far ahead the parser looks.
 class Lexer {
 public:
-  Lexer(const std::string &src) : source(src) {}
+  static constexpr size_t MaxLookahead = 4; // power of two
+
+  Lexer(std::string_view src) : source(src) {}
   Token nextToken();
-  Token peekToken();
+
+  /// The token `distance` positions past the one nextToken() returns next
+  /// (0 = that token itself). Aborts if `distance` is not below MaxLookahead.
+  const Token &peekToken(size_t distance = 0);
+
+  size_t tokenCount() const { return this->tokens; }
 
 private:
-  const std::string &source;
+  std::string_view source;
   size_t pos = 0;
   int line = 1;
   int column = 1;
+  size_t tokens = 0;
 
-  size_t savedPos;
-  int savedLine;
-  int savedColumn;
+  Token lookahead[MaxLookahead];
+  size_t lookaheadHead = 0;
+  size_t lookaheadCount = 0;
 
   [[deprecated("Whitespace skipping is handled in Lexer::skipComment().")]]
   void skipWhitespace();
   void skipComment();
 
+  Token lexToken();
+
   Token number();
   Token identifier();
   Token stringLiteral();
@@ -1,27 +1,170 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "Symbol.hpp"
+
 struct ExportedFunction {
-  std::string name;
-  std::vector<std::pair<std::string, std::string>> params; // (name, type)
+  Symbol name;
+  std::vector<std::pair<Symbol, std::string>> params; // (name, type)
   std::string returnType;
 };
 
 struct ExportedStruct {
-  std::string name;
-  std::vector<std::pair<std::string, std::string>> fields; // (name, type)
+  Symbol name;
+  std::vector<std::pair<Symbol, std::string>> fields; // (name, type)
 };
 
+/// The exports of the module being compiled, as collected by Codegen.
 struct ModuleMetadata {
   std::string moduleName;
   std::vector<ExportedFunction> functions;
   std::vector<ExportedStruct> structs;
 
-  void saveToFile(const std::string &filepath) const;
-  static ModuleMetadata loadFromFile(const std::string &filepath);
-  const ExportedFunction *findFunction(const std::string &name) const;
-  const ExportedStruct *findStruct(const std::string &name) const;
+  /// Write the binary .racm read back by ModuleInterface.
+  bool saveToFile(const std::string &filepath) const;
+  /// Write the human-readable dump produced by --emit-racm-text.
+  bool saveTextToFile(const std::string &filepath) const;
+
+  /// Hash of the binary .racm. Equal fingerprints mean byte-identical
+  /// interfaces, so importers compiled against one need no rebuild.
+  uint64_t fingerprint() const;
+
+private:
+  /// The binary .racm image.
+  std::string serialize() const;
+};
+
+/// On-disk layout of a binary .racm file. Every field is a little-endian
+/// uint32; strings are offsets into a table of null-terminated names.
+///
+///   Header
+///   FunctionRecord[functionCount]
+///   StructRecord[structCount]
+///   MemberRecord[memberCount]   params and fields, referenced by range
+///   Bucket[bucketCount]         open-addressed index over functions+structs
+///   char strings[stringsSize]
+namespace racm {
+
+using Word = llvm::support::ulittle32_t;
+
+constexpr char Magic[4] = {'R', 'A', 'C', 'M'};
+/// Bump whenever the layout below changes.
+constexpr uint32_t Version = 1;
+constexpr uint32_t EmptyBucket = ~0u;
+/// Set in Bucket::entry when it refers to a struct rather than a function.
+constexpr uint32_t StructEntry = 1u << 31;
+
+struct Header {
+  char magic[4];
+  Word version;
+  Word moduleName;
+  Word functionCount;
+  Word structCount;
+  Word memberCount;
+  Word bucketCount; // power of two
+  Word stringsSize;
+};
+
+struct FunctionRecord {
+  Word name;
+  Word returnType;
+  Word firstParam;
+  Word paramCount;
+};
+
+struct StructRecord {
+  Word name;
+  Word firstField;
+  Word fieldCount;
+};
+
+struct MemberRecord {
+  Word name;
+  Word type;
+};
+
+struct Bucket {
+  Word hash; // djbHash of the name
+  Word entry;
+};
+
+} // namespace racm
+
+/// Read-only view of an imported module's binary .racm.
+///
+/// The file is mapped (or read once, when it is small) and never parsed:
+/// records are accessed in place and names are looked up through the file's
+/// hash index, so resolving an imported symbol does not allocate.
+class ModuleInterface {
+public:
+  /// Open and validate a .racm file. Prints an error and returns nullptr if
+  /// it is missing, truncated, or written by an incompatible compiler.
+  ///
+  /// Goes through a process-wide cache: a file already opened with the same
+  /// identity, size and modification time is shared rather than read again.
+  /// The compile server fills the cache before it forks, so that its workers
+  /// start with their imports' interfaces loaded.
+  static std::shared_ptr<const ModuleInterface>
+  openCached(const std::string &filepath);
+  /// Add `filepath` to openCached's cache. Returns false, without printing
+  /// anything, if it is not a valid interface.
+  static bool preload(const std::string &filepath);
+
+  std::string_view getModuleName() const {
+    return this->getString(this->header->moduleName);
+  }
+
+  const racm::FunctionRecord *findFunction(std::string_view name) const;
+  const racm::StructRecord *findStruct(std::string_view name) const;
+
+  llvm::ArrayRef<racm::StructRecord> getStructs() const {
+    return this->structs;
+  }
+  llvm::ArrayRef<racm::MemberRecord>
+  getParams(const racm::FunctionRecord &func) const {
+    return this->getMembers(func.firstParam, func.paramCount);
+  }
+  llvm::ArrayRef<racm::MemberRecord>
+  getFields(const racm::StructRecord &st) const {
+    return this->getMembers(st.firstField, st.fieldCount);
+  }
+
+  /// The string at `offset` in the string table ("" if out of range).
+  std::string_view getString(uint32_t offset) const;
+
+private:
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  const racm::Header *header = nullptr;
+  llvm::ArrayRef<racm::FunctionRecord> functions;
+  llvm::ArrayRef<racm::StructRecord> structs;
+  llvm::ArrayRef<racm::MemberRecord> members;
+  llvm::ArrayRef<racm::Bucket> buckets;
+  const char *strings = nullptr;
+  uint32_t stringsSize = 0;
+
+  ModuleInterface() = default;
+
+  /// Uncached and cached loads that do not print: on failure `error` says
+  /// why.
+  static std::unique_ptr<ModuleInterface> load(const std::string &filepath,
+                                               std::string &error);
+  static std::shared_ptr<const ModuleInterface>
+  loadCached(const std::string &filepath, std::string &error);
+
+  /// members[first, first + count), or empty if that runs past the end.
+  llvm::ArrayRef<racm::MemberRecord> getMembers(uint32_t first,
+                                                uint32_t count) const;
+
+  /// Index of the bucket entry for `name` with the given kind bit, or
+  /// racm::EmptyBucket if there is none.
+  uint32_t lookup(std::string_view name, uint32_t kind) const;
 };
@@ -1,24 +1,32 @@
 #pragma once
 
 #include "AST.hpp"
+#include "Arena.hpp"
 #include "Lexer.hpp"
 #include "Token.hpp"
+#include "Type.hpp"
 
 class Parser {
   Lexer &lexer;
+  Arena &arena; // every node the parser creates lives here
+  TypeContext &types;
 
 public:
   Token current;
-  Parser(Lexer &l) : lexer(l) { this->advance(); }
+  Parser(Lexer &l, Arena &a, TypeContext &t) : lexer(l), arena(a), types(t) {
+    this->advance();
+  }
 
   void advance();
-  Token peek();
+  // Token `distance` positions after `current` (0 = the very next one).
+  const Token &peek(size_t distance = 0);
 
   Expr *parseExpression(int precedence = 0);
 
   Statement *parseStatement(bool insideFunction = false);
   Statement *parseVarDecl(bool isConst);
   Statement *parseFunctionDecl(bool isExternal = false);
+  Statement *parseAttributedFunctionDecl();
   Statement *parseIfStatement();
   Statement *parseWhileStatement();
   Statement *parseForStatement();
@@ -33,6 +41,9 @@ public:
 
   Expr *parseUnary();
 
+  // type := (Identifier ('.' Identifier)? | 'void') '*'*
+  const Type *parseType();
+
 private:
   int getPrecedence(TokenType type);
 
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+/// The driver's entry point: parse `argv` and compile, returning the exit
+/// status.
+using CompileFunction = int (*)(int argc, const char *argv[]);
+
+/// Run `raccoonc --server`: accept compile requests from raccoonc-client on
+/// the Unix socket at `socketPath` until killed, or until the raccoonc
+/// executable at `argv0` is replaced by a new build.
+///
+/// The server process stays warm (libLLVM loaded and relocated, targets
+/// registered) and forks a fresh worker per request, which runs `compile`
+/// with the client's argv, working directory, environment, stdout and stderr.
+/// A worker that aborts on a compile error takes nothing else down with it.
+/// At most one request per core is served at a time.
+///
+/// Before forking, the server loads the .racm interfaces found under the
+/// directories of the request's .rac files and keeps them, keyed by path and
+/// modification time, so workers inherit their imports already loaded.
+/// Parsed ASTs are not kept: a worker parses only the modules it rebuilds,
+/// and the build state already skips the unchanged ones.
+int runServer(const std::string &socketPath, const char *argv0,
+              CompileFunction compile);
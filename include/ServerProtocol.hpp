@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// The wire protocol between `raccoonc --server` and `raccoonc-client`, over
+/// a Unix stream socket. Shared by both sides; it does not depend on LLVM so
+/// that the client stays small and starts fast.
+///
+/// One connection carries one compile:
+///
+///   client -> server   RequestHeader, with the client's stdout and stderr
+///                      attached as SCM_RIGHTS
+///                      String cwd
+///                      String argv[1..argc)
+///                      String environ[0..envCount), each NAME=value
+///   server -> client   int32 exit status (128 + N if killed by signal N)
+///
+/// A String is a uint32 length followed by that many bytes. Integers are in
+/// host byte order; both ends are on the same machine. If the connection
+/// closes before the status arrives, the client compiles by itself instead.
+namespace server {
+
+constexpr char Magic[4] = {'R', 'A', 'C', 'S'};
+/// Bump whenever the layout above changes.
+constexpr uint32_t Version = 2;
+
+struct RequestHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t argCount; // not counting argv[0] or cwd
+  uint32_t envCount;
+};
+
+/// $RACCOONC_SOCKET if set, else raccoonc.sock in $XDG_RUNTIME_DIR, else
+/// /tmp/raccoonc-<uid>.sock.
+std::string getSocketPath();
+
+bool writeAll(int fd, const void *data, size_t size);
+bool readAll(int fd, void *data, size_t size);
+bool writeString(int fd, const std::string &str);
+bool readString(int fd, std::string &str);
+
+/// Send `size` bytes with `fds` attached.
+bool sendWithFds(int socket, const void *data, size_t size,
+                 const std::vector<int> &fds);
+/// Receive exactly `size` bytes and up to `maxFds` attached descriptors.
+bool receiveWithFds(int socket, void *data, size_t size, std::vector<int> &fds,
+                    size_t maxFds);
+
+} // namespace server
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string_view>
+
+#include <llvm/ADT/DenseMapInfo.h>
+
+/// An interned identifier.
+///
+/// Every distinct spelling is stored once in a process-wide table and named by
+/// a 32-bit id, so comparing or hashing a Symbol is an integer operation. The
+/// lexer interns identifiers as it produces them; everything downstream
+/// (AST, Codegen, ModuleMetadata) passes Symbols around instead of strings.
+/// Interned text is never freed. The table may be used from several threads.
+class Symbol {
+public:
+  /// The empty symbol, spelled "".
+  constexpr Symbol() = default;
+
+  static Symbol intern(std::string_view text);
+
+  /// The symbol for "<module>_<name>", the spelling used for exported
+  /// functions and structs. Computed once per pair and cached.
+  static Symbol mangle(Symbol module, Symbol name);
+
+  std::string_view str() const;
+  /// Same text as str(); interned spellings are always null-terminated.
+  const char *c_str() const { return this->str().data(); }
+
+  uint32_t id() const { return this->value; }
+  bool empty() const { return this->value == 0; }
+
+  friend bool operator==(Symbol a, Symbol b) { return a.value == b.value; }
+  friend bool operator!=(Symbol a, Symbol b) { return a.value != b.value; }
+
+private:
+  friend struct llvm::DenseMapInfo<Symbol>;
+
+  explicit constexpr Symbol(uint32_t value) : value(value) {}
+
+  uint32_t value = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &out, Symbol symbol) {
+  return out << symbol.str();
+}
+
+template <> struct llvm::DenseMapInfo<Symbol> {
+  static inline Symbol getEmptyKey() { return Symbol(~0u); }
+  static inline Symbol getTombstoneKey() { return Symbol(~0u - 1); }
+  static unsigned getHashValue(Symbol symbol) {
+    return DenseMapInfo<uint32_t>::getHashValue(symbol.id());
+  }
+  static bool isEqual(Symbol a, Symbol b) { return a == b; }
+};
+
+template <> struct std::hash<Symbol> {
+  size_t operator()(Symbol symbol) const { return symbol.id(); }
+};
@@ -1,10 +1,33 @@
 #pragma once
 
-#include <string>
+#include <string_view>
+
+#include "Symbol.hpp"
 
 enum class TokenType {
   Identifier,
-  Keyword,
+
+  // Keywords. Keep these contiguous (KwFun..KwExtern); isKeyword() relies on
+  // it and the lexer's keyword table lists every one of them.
+  KwFun,
+  KwLet,
+  KwConst,
+  KwStruct,
+  KwReturn,
+  KwIf,
+  KwElse,
+  KwWhile,
+  KwFor,
+  KwImport,
+  KwExport,
+  KwMalloc,
+  KwFree,
+  KwTrue,
+  KwFalse,
+  KwVoid,
+  KwRestrict,
+  KwExtern,
+
   IntLiteral,
   StringLiteral,
   CharLiteral,
@@ -34,12 +57,18 @@ enum class TokenType {
   Pipe,
   OrOr,
   Percent,
+  At,
   EndOfFile
 };
 
+inline bool isKeyword(TokenType type) {
+  return type >= TokenType::KwFun && type <= TokenType::KwExtern;
+}
+
 struct Token {
   TokenType type;
-  std::string lexeme;
+  std::string_view lexeme; // view into the unit's source buffer
   int line;
   int column;
+  Symbol symbol; // interned lexeme, identifiers only
 };
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <llvm/ADT/DenseMap.h>
+
+#include "Arena.hpp"
+#include "Symbol.hpp"
+
+namespace llvm {
+class Type;
+}
+
+/// A source-level type: a primitive, a pointer, or a reference to a struct
+/// (optionally qualified by the module that exports it).
+///
+/// Types are hash-consed by a TypeContext, so two Types with the same spelling
+/// are the same object and can be compared by pointer. They live in the unit's
+/// arena and are immutable apart from the cached llvm::Type, which Codegen
+/// fills in the first time it lowers the type.
+class Type {
+public:
+  enum class Kind : uint8_t { Void, Bool, Char, Int, Float, Pointer, Struct };
+
+  Kind getKind() const { return this->kind; }
+  bool isVoid() const { return this->kind == Kind::Void; }
+  bool isPointer() const { return this->kind == Kind::Pointer; }
+  bool isStruct() const { return this->kind == Kind::Struct; }
+  /// u8..u128 and usize. Everything else, including bool and char, is signed.
+  bool isUnsigned() const { return this->kind == Kind::Int && !this->isSigned; }
+
+  /// Width of an Int or Float type in bits.
+  unsigned getBitWidth() const { return this->bits; }
+  /// For Pointer types, the type pointed to; nullptr otherwise.
+  const Type *getPointee() const { return this->pointee; }
+  /// Strips every level of pointer: i32** -> i32.
+  const Type *getBaseType() const;
+
+  /// The spelled name of a primitive or struct type ("i32", "Point").
+  Symbol getName() const { return this->name; }
+  /// The module qualifier of a struct type ("geo" in geo.Point), or empty.
+  Symbol getModule() const { return this->module; }
+
+  /// The spelling used in source and in .racm files, e.g. "geo.Point*".
+  std::string str() const;
+
+  /// The lowered type, or nullptr if Codegen has not resolved it yet. Only
+  /// valid for the Codegen (and LLVMContext) of the unit that owns this type.
+  llvm::Type *getLLVMType() const { return this->llvmType; }
+  void setLLVMType(llvm::Type *type) const { this->llvmType = type; }
+
+private:
+  friend class TypeContext;
+
+  Type(Kind kind, Symbol name, unsigned bits = 0, bool isSigned = true)
+      : kind(kind), isSigned(isSigned), bits(bits), name(name) {}
+
+  Kind kind;
+  bool isSigned;
+  uint16_t bits;
+  const Type *pointee = nullptr;
+  Symbol name;
+  Symbol module;
+  mutable const Type *pointerTo = nullptr; // unique T* for this T
+  mutable llvm::Type *llvmType = nullptr;
+};
+
+/// Owns and uniques every Type of one compilation unit.
+///
+/// The parser builds types through here as it reads annotations; Codegen uses
+/// the same context to turn the type spellings in imported .racm files into
+/// Types. Lookups are keyed by interned Symbols, so resolving a name is one
+/// integer hash.
+class TypeContext {
+public:
+  explicit TypeContext(Arena &arena);
+
+  TypeContext(const TypeContext &) = delete;
+  TypeContext &operator=(const TypeContext &) = delete;
+
+  /// A primitive, or a reference to a struct of the current module.
+  const Type *getNamed(Symbol name);
+  /// A struct exported by another module (module.Name).
+  const Type *getQualified(Symbol module, Symbol name);
+  const Type *getPointerTo(const Type *pointee);
+
+  /// Parse a spelling such as "i32", "Point*" or "geo.Point**".
+  const Type *parse(std::string_view spelling);
+
+  const Type *getVoid() const { return this->voidType; }
+  const Type *getBool() const { return this->boolType; }
+  const Type *getChar() const { return this->charType; }
+  const Type *getI32() const { return this->i32Type; }
+  const Type *getF32() const { return this->f32Type; }
+
+private:
+  Arena &arena;
+  llvm::DenseMap<Symbol, const Type *> named;
+  llvm::DenseMap<std::pair<Symbol, Symbol>, const Type *> qualified;
+
+  const Type *voidType;
+  const Type *boolType;
+  const Type *charType;
+  const Type *i32Type;
+  const Type *f32Type;
+
+  const Type *addPrimitive(std::string_view spelling, Type::Kind kind,
+                           unsigned bits = 0, bool isSigned = true);
+};
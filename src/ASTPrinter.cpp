@@ -27,26 +27,90 @@ std::ostream &operator<<(std::ostream &out, const TokenType &value) {
   }();
 }
 
-void printExpr(Expr *expr, int indent) {
-  std::string pad(indent, '\t');
-  if (auto intLit = dynamic_cast<IntLiteral *>(expr)) {
+namespace {
+
+class Printer : public ExprVisitor<Printer>, public StmtVisitor<Printer> {
+public:
+  explicit Printer(int indent) : indent(indent), pad(indent, '\t') {}
+
+  void visitIntLiteral(IntLiteral *intLit) {
     std::cout << pad << "IntLiteral: " << intLit->value << "\n";
-  } else if (auto var = dynamic_cast<Variable *>(expr)) {
+  }
+
+  void visitVariable(Variable *var) {
     std::cout << pad << "Variable: " << var->name << "\n";
-  } else if (auto bin = dynamic_cast<BinaryExpr *>(expr)) {
+  }
+
+  void visitBinaryExpr(BinaryExpr *bin) {
     std::cout << pad << "BinaryExpr: " << bin->op << "\n";
     printExpr(bin->left, indent + 2);
     printExpr(bin->right, indent + 2);
-  } else if (auto call = dynamic_cast<CallExpr *>(expr)) {
+  }
+
+  void visitCallExpr(CallExpr *call) {
     std::cout << pad << "CallExpr: " << call->name << "\n";
     for (auto &arg : call->args) {
       printExpr(arg, indent + 2);
     }
-  } else if (auto unary = dynamic_cast<UnaryExpr *>(expr)) {
+  }
+
+  void visitUnaryExpr(UnaryExpr *unary) {
     std::cout << pad << "UnaryExpr: " << unary->op << "\n";
     printExpr(unary->operand, indent + 2);
   }
-}
+
+  void visitVarDecl(VarDecl *varDecl) {
+    std::cout << pad << "VarDecl: " << varDecl->name << " : "
+              << varDecl->type->str() << "\n";
+    if (varDecl->initializer)
+      printExpr(varDecl->initializer, indent + 2);
+  }
+
+  void visitExprStmt(ExprStmt *exprStmt) {
+    std::cout << pad << "ExprStmt:\n";
+    printExpr(exprStmt->expr, indent + 2);
+  }
+
+  void visitFunctionDecl(FunctionDecl *funcDecl) {
+    std::cout << pad << "FunctionDecl: " << funcDecl->name << " -> "
+              << funcDecl->returnType->str() << "\n";
+    for (auto &param : funcDecl->params) {
+      std::cout << pad << "\tParam: " << param.first << " : "
+                << param.second->str() << "\n";
+    }
+    std::cout << pad << "\tBody:\n";
+    for (auto &s : funcDecl->body)
+      printStatement(s, indent + 2);
+  }
+
+  void visitIfStmt(IfStmt *ifs) { printIfStmt(ifs, indent); }
+  void visitWhileStmt(WhileStmt *whiles) { printWhileStmt(whiles, indent); }
+  void visitForStmt(ForStmt *fors) { printForStmt(fors, indent); }
+
+  void visitReturnStmt(ReturnStmt *ret) {
+    std::cout << pad << "ReturnStmt:\n";
+    if (ret->value) {
+      printExpr(ret->value, indent + 2);
+    } else {
+      std::cout << pad << "\t(void)\n";
+    }
+  }
+
+  void visitBlockStmt(BlockStmt *block) {
+    std::cout << pad << "BlockStmt:\n";
+    for (auto &s : block->statements) {
+      printStatement(s, indent + 2);
+    }
+  }
+
+private:
+  int indent;
+  std::string pad;
+};
+
+} // namespace
+
+void printExpr(Expr *expr, int indent) { Printer(indent).visitExpr(expr); }
 
 void printIfStmt(IfStmt *ifs, int indent) {
   std::string pad(indent, '\t');
@@ -92,42 +156,5 @@ void printForStmt(ForStmt *fors, int indent) {
 }
 
 void printStatement(Statement *stmt, int indent) {
-  std::string pad(indent, '\t');
-  if (auto varDecl = dynamic_cast<VarDecl *>(stmt)) {
-    std::cout << pad << "VarDecl: " << varDecl->name << " : " << varDecl->type
-              << "\n";
-    if (varDecl->initializer)
-      printExpr(varDecl->initializer, indent + 2);
-  } else if (auto exprStmt = dynamic_cast<ExprStmt *>(stmt)) {
-    std::cout << pad << "ExprStmt:\n";
-    printExpr(exprStmt->expr, indent + 2);
-  } else if (auto funcDecl = dynamic_cast<FunctionDecl *>(stmt)) {
-    std::cout << pad << "FunctionDecl: " << funcDecl->name << " -> "
-              << funcDecl->returnType << "\n";
-    for (auto &param : funcDecl->params) {
-      std::cout << pad << "\tParam: " << param.first << " : " << param.second
-                << "\n";
-    }
-    std::cout << pad << "\tBody:\n";
-    for (auto &s : funcDecl->body)
-      printStatement(s, indent + 2);
-  } else if (auto ifs = dynamic_cast<IfStmt *>(stmt)) {
-    printIfStmt(ifs, indent);
-  } else if (auto whiles = dynamic_cast<WhileStmt *>(stmt)) {
-    printWhileStmt(whiles, indent);
-  } else if (auto fors = dynamic_cast<ForStmt *>(stmt)) {
-    printForStmt(fors, indent);
-  } else if (auto ret = dynamic_cast<ReturnStmt *>(stmt)) {
-    std::cout << pad << "ReturnStmt:\n";
-    if (ret->value) {
-      printExpr(ret->value, indent + 2);
-    } else {
-      std::cout << pad << "\t(void)\n";
-    }
-  } else if (auto block = dynamic_cast<BlockStmt *>(stmt)) {
-    std::cout << pad << "BlockStmt:\n";
-    for (auto &s : block->statements) {
-      printStatement(s, indent + 2);
-    }
-  }
+  Printer(indent).visitStmt(stmt);
 }
@@ -0,0 +1,82 @@
+#include "Arena.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+static size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+  size_t curAddr = reinterpret_cast<size_t>(this->cur);
+  size_t aligned = alignUp(curAddr, alignment);
+
+  if (this->cur && aligned + bytes <= reinterpret_cast<size_t>(this->end)) {
+    this->cur = reinterpret_cast<char *>(aligned + bytes);
+    this->used += bytes;
+    return reinterpret_cast<void *>(aligned);
+  }
+
+  return this->allocateSlow(bytes, alignment);
+}
+
+void *Arena::allocateSlow(size_t bytes, size_t alignment) {
+  size_t header = alignUp(sizeof(Chunk), alignof(std::max_align_t));
+  size_t payload = bytes + alignment;
+  size_t size =
+      header + (payload > this->chunkSize ? payload : this->chunkSize);
+
+  auto *chunk = static_cast<Chunk *>(std::malloc(size));
+  if (!chunk) {
+    throw std::bad_alloc();
+  }
+
+  chunk->next = this->head;
+  chunk->size = size;
+  this->head = chunk;
+  this->chunks++;
+  this->reserved += size;
+
+  char *begin = reinterpret_cast<char *>(chunk) + header;
+  char *chunkEnd = reinterpret_cast<char *>(chunk) + size;
+
+  size_t aligned = alignUp(reinterpret_cast<size_t>(begin), alignment);
+  char *result = reinterpret_cast<char *>(aligned);
+
+  // Oversized requests get a dedicated chunk; keep bumping in the current one
+  // if it still has more room left than the new chunk does.
+  if (payload <= this->chunkSize ||
+      (chunkEnd - (result + bytes)) > (this->end - this->cur)) {
+    this->cur = result + bytes;
+    this->end = chunkEnd;
+  }
+
+  this->used += bytes;
+  return result;
+}
+
+std::string_view Arena::copyString(std::string_view str) {
+  if (str.empty()) {
+    return {};
+  }
+
+  char *mem = static_cast<char *>(this->allocate(str.size(), 1));
+  std::memcpy(mem, str.data(), str.size());
+  return std::string_view(mem, str.size());
+}
+
+void Arena::release() {
+  Chunk *chunk = this->head;
+  while (chunk) {
+    Chunk *next = chunk->next;
+    std::free(chunk);
+    chunk = next;
+  }
+
+  this->head = nullptr;
+  this->cur = nullptr;
+  this->end = nullptr;
+  this->used = 0;
+  this->reserved = 0;
+  this->chunks = 0;
+}
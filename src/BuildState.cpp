@@ -0,0 +1,133 @@
+#include "BuildState.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <llvm/Support/xxhash.h>
+
+namespace {
+
+/// Bump whenever the format below changes.
+constexpr int FormatVersion = 3;
+
+} // namespace
+
+void BuildState::load(const std::string &filepath) {
+  this->units.clear();
+
+  std::ifstream file(filepath);
+  if (!file) {
+    return;
+  }
+
+  // Boring text format:
+  // RACBUILD <version>
+  // UNIT <objectFile>
+  //   FRONTEND <hash>
+  //   CONFIG <hash>
+  //   SOURCE <hash>
+  //   IMPORT <module> <hash>
+  //   ...
+  //   INTERFACE <hash>
+  std::string line;
+  int version = 0;
+  if (!std::getline(file, line) ||
+      std::sscanf(line.c_str(), "RACBUILD %d", &version) != 1 ||
+      version != FormatVersion) {
+    return;
+  }
+
+  UnitInputs *current = nullptr;
+  while (std::getline(file, line)) {
+    std::istringstream in(line);
+    std::string keyword;
+    in >> keyword;
+
+    if (keyword == "UNIT") {
+      std::string objectFile = line.substr(line.find(' ') + 1);
+      current = &this->units[objectFile];
+    } else if (!current) {
+      break;
+    } else if (keyword == "FRONTEND") {
+      in >> std::hex >> current->frontend;
+    } else if (keyword == "CONFIG") {
+      in >> std::hex >> current->config;
+    } else if (keyword == "SOURCE") {
+      in >> std::hex >> current->source;
+    } else if (keyword == "IMPORT") {
+      std::string module;
+      uint64_t hash = 0;
+      in >> module >> std::hex >> hash;
+      current->imports.emplace_back(std::move(module), hash);
+    } else if (keyword == "INTERFACE") {
+      in >> std::hex >> current->interface;
+    } else {
+      break;
+    }
+
+    if (in.fail()) {
+      break;
+    }
+  }
+
+  if (!file.eof()) {
+    // Anything unexpected: forget it all rather than trust half of it.
+    this->units.clear();
+  }
+}
+
+bool BuildState::save(const std::string &filepath) const {
+  // Write beside the old state and swap it in, so an interrupted build never
+  // leaves a truncated file behind.
+  std::string tempPath = filepath + ".tmp";
+  {
+    std::ofstream file(tempPath);
+    if (!file) {
+      std::cerr << "Error: Cannot write build state: " << tempPath << "\n";
+      return false;
+    }
+
+    file << "RACBUILD " << FormatVersion << "\n" << std::hex;
+    for (const auto &[objectFile, inputs] : this->units) {
+      file << "UNIT " << objectFile << "\n";
+      file << "  FRONTEND " << inputs.frontend << "\n";
+      file << "  CONFIG " << inputs.config << "\n";
+      file << "  SOURCE " << inputs.source << "\n";
+      for (const auto &[module, hash] : inputs.imports) {
+        file << "  IMPORT " << module << " " << hash << "\n";
+      }
+      file << "  INTERFACE " << inputs.interface << "\n";
+    }
+
+    file.close();
+    if (!file) {
+      std::cerr << "Error: Cannot write build state: " << tempPath << "\n";
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tempPath, filepath, ec);
+  if (ec) {
+    std::cerr << "Error: Cannot write build state: " << filepath << ": "
+              << ec.message() << "\n";
+    return false;
+  }
+  return true;
+}
+
+const UnitInputs *BuildState::find(const std::string &objectFile) const {
+  auto it = this->units.find(objectFile);
+  return it == this->units.end() ? nullptr : &it->second;
+}
+
+void BuildState::record(const std::string &objectFile, UnitInputs inputs) {
+  this->units[objectFile] = std::move(inputs);
+}
+
+uint64_t BuildState::hash(std::string_view data) {
+  return llvm::xxh3_64bits(llvm::StringRef(data.data(), data.size()));
+}
@@ -2,7 +2,105 @@
 #include "AST.hpp"
 #include "Token.hpp"
 
-using namespace llvm;
+#include <algorithm>
+
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/GlobalIFunc.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+namespace {
+
+/// x86 features @target_clones can select, lowest priority first. `bit` is
+/// the feature's bit in __cpu_model.__cpu_features[0], as laid out by libgcc
+/// and compiler-rt.
+struct CloneFeature {
+  std::string_view name;
+  unsigned bit;
+};
+
+constexpr CloneFeature CloneFeatures[] = {
+    {"popcnt", 2},   {"sse3", 5},      {"ssse3", 6},     {"sse4.1", 7},
+    {"sse4.2", 8},   {"aes", 18},      {"pclmul", 19},   {"avx", 9},
+    {"fma", 14},     {"bmi", 16},      {"bmi2", 17},     {"avx2", 10},
+    {"avx512f", 15}, {"avx512cd", 23}, {"avx512dq", 22}, {"avx512bw", 21},
+    {"avx512vl", 20},
+};
+
+/// Collects the names used as `&name` in a function body.
+class AddressTakenFinder : public ExprVisitor<AddressTakenFinder>,
+                           public StmtVisitor<AddressTakenFinder> {
+public:
+  llvm::DenseSet<Symbol> names;
+
+  void visitStmts(const ArenaVector<Statement *> &stmts) {
+    for (Statement *stmt : stmts) {
+      this->visitStmt(stmt);
+    }
+  }
+
+  void visitVarDecl(VarDecl *stmt) {
+    if (stmt->initializer) {
+      this->visitExpr(stmt->initializer);
+    }
+  }
+  void visitExprStmt(ExprStmt *stmt) { this->visitExpr(stmt->expr); }
+  void visitIfStmt(IfStmt *stmt) {
+    this->visitExpr(stmt->condition);
+    this->visitStmts(stmt->thenBranch);
+    this->visitStmts(stmt->elseBranch);
+  }
+  void visitWhileStmt(WhileStmt *stmt) {
+    this->visitExpr(stmt->condition);
+    this->visitStmts(stmt->body);
+  }
+  void visitForStmt(ForStmt *stmt) {
+    if (stmt->initializer) {
+      this->visitStmt(stmt->initializer);
+    }
+    if (stmt->condition) {
+      this->visitExpr(stmt->condition);
+    }
+    if (stmt->increment) {
+      this->visitExpr(stmt->increment);
+    }
+    this->visitStmts(stmt->body);
+  }
+  void visitReturnStmt(ReturnStmt *stmt) {
+    if (stmt->value) {
+      this->visitExpr(stmt->value);
+    }
+  }
+  void visitBlockStmt(BlockStmt *stmt) { this->visitStmts(stmt->statements); }
+
+  void visitStructLiteral(StructLiteral *expr) {
+    for (auto &field : expr->fields) {
+      this->visitExpr(field.second);
+    }
+  }
+  void visitUnaryExpr(UnaryExpr *expr) {
+    if (expr->op == TokenType::Ampersand) {
+      if (auto *var = llvm::dyn_cast<Variable>(expr->operand)) {
+        this->names.insert(var->name);
+      }
+    }
+    this->visitExpr(expr->operand);
+  }
+  void visitBinaryExpr(BinaryExpr *expr) {
+    this->visitExpr(expr->left);
+    this->visitExpr(expr->right);
+  }
+  void visitCallExpr(CallExpr *expr) {
+    for (Expr *arg : expr->args) {
+      this->visitExpr(arg);
+    }
+  }
+  void visitMemberAccessExpr(MemberAccessExpr *expr) {
+    this->visitExpr(expr->object);
+  }
+};
+
+} // namespace
 
 llvm::Value *Codegen::castIntegerIfNeeded(llvm::IRBuilder<> *builder,
                                           llvm::Value *val, llvm::Type *fromTy,
@@ -34,117 +132,108 @@ llvm::Value *Codegen::castIntegerIfNeeded(llvm::IRBuilder<> *builder,
 
 llvm::Value *
 Codegen::findLValueStorage(llvm::Module *module,
-                           std::unordered_map<std::string, LocalVar> &locals,
-                           const std::string &name) {
+                           llvm::DenseMap<Symbol, LocalVar> &locals,
+                           Symbol name) {
   auto it = locals.find(name);
   if (it != locals.end()) {
     return it->second.alloca;
   }
 
-  if (auto *g = module->getGlobalVariable(name)) {
+  if (auto *g = module->getGlobalVariable(name.str())) {
     return g;
   }
 
   return nullptr;
 }
 
-llvm::Type *Codegen::getLLVMType(const std::string &type, LLVMContext &ctx) {
-  if (type.back() == '*') {
-    return llvm::PointerType::getUnqual(
-        getLLVMType(type.substr(0, type.size() - 1), ctx));
-  }
-
-  // Handle qualified type names (module.Type)
-  std::string lookupName = type;
-  size_t dotPos = type.find('.');
-  if (dotPos != std::string::npos) {
-    // Convert "module.Type" to "module_Type"
-    std::string moduleName = type.substr(0, dotPos);
-    std::string typeName = type.substr(dotPos + 1);
-    lookupName = moduleName + "_" + typeName;
-  } else if (!this->currentModuleName.empty()) {
-    // For local types in a module, try mangled name first
-    std::string mangledName = this->currentModuleName + "_" + type;
-    auto it = this->structTypes.find(mangledName);
-    if (it != this->structTypes.end()) {
-      return it->second;
+llvm::Type *Codegen::getLLVMType(const Type *type) {
+  if (llvm::Type *cached = type->getLLVMType()) {
+    return cached;
+  }
+
+  llvm::Type *result = nullptr;
+  switch (type->getKind()) {
+  case Type::Kind::Void:
+    result = llvm::Type::getVoidTy(this->context);
+    break;
+  case Type::Kind::Bool:
+  case Type::Kind::Char:
+    result = llvm::Type::getInt8Ty(this->context);
+    break;
+  case Type::Kind::Int:
+    result = llvm::Type::getIntNTy(this->context, type->getBitWidth());
+    break;
+  case Type::Kind::Float:
+    result = type->getBitWidth() == 64 ? llvm::Type::getDoubleTy(this->context)
+                                       : llvm::Type::getFloatTy(this->context);
+    break;
+  case Type::Kind::Pointer: {
+    llvm::Type *pointee = this->getLLVMType(type->getPointee());
+    result = llvm::PointerType::getUnqual(pointee);
+    if (!type->getPointee()->getLLVMType()) {
+      return result; // pointee not resolved yet; don't cache
     }
-    // Fall through to check primitive types
-  }
-
-  auto it = this->structTypes.find(lookupName);
-  if (it != this->structTypes.end()) {
-    return it->second;
-  }
-
-  if (type == "i8") {
-    return llvm::Type::getInt8Ty(ctx);
-  }
-  if (type == "i16") {
-    return llvm::Type::getInt16Ty(ctx);
-  }
-  if (type == "i32") {
-    return llvm::Type::getInt32Ty(ctx);
-  }
-  if (type == "i64") {
-    return llvm::Type::getInt64Ty(ctx);
+    break;
   }
-  if (type == "i128") {
-    return llvm::Type::getInt128Ty(ctx);
-  }
-
-  if (type == "u8") {
-    return llvm::Type::getInt8Ty(ctx);
-  }
-  if (type == "u16") {
-    return llvm::Type::getInt16Ty(ctx);
-  }
-  if (type == "u32") {
-    return llvm::Type::getInt32Ty(ctx);
-  }
-  if (type == "u64") {
-    return llvm::Type::getInt64Ty(ctx);
+  case Type::Kind::Struct: {
+    auto it = this->structTypes.find(this->resolveStructName(type));
+    if (it == this->structTypes.end()) {
+      // Unknown names fall back to i32. Not cached: the struct may still be
+      // declared later in the unit.
+      return llvm::Type::getInt32Ty(this->context);
+    }
+    result = it->second;
+    break;
   }
-  if (type == "u128") {
-    return llvm::Type::getInt128Ty(ctx);
   }
 
-  if (type == "usize") {
-    return llvm::Type::getInt64Ty(ctx);
-    // TODO: Use data layout for actual pointer size
-  }
+  type->setLLVMType(result);
+  return result;
+}
 
-  if (type == "f32") {
-    return llvm::Type::getFloatTy(ctx);
-  }
-  if (type == "f64") {
-    return llvm::Type::getDoubleTy(ctx);
+Symbol Codegen::resolveStructName(const Type *type) {
+  if (!type->getModule().empty()) {
+    // Convert "module.Type" to "module_Type"
+    return Symbol::mangle(type->getModule(), type->getName());
   }
 
-  if (type == "bool") {
-    return llvm::Type::getInt8Ty(ctx);
+  if (!this->currentModuleName.empty()) {
+    // For local types in a module, prefer the mangled name
+    Symbol mangledName =
+        Symbol::mangle(this->currentModuleName, type->getName());
+    if (this->structTypes.count(mangledName)) {
+      return mangledName;
+    }
   }
+  return type->getName();
+}
 
-  if (type == "void") {
-    return llvm::Type::getVoidTy(ctx);
+const Type *Codegen::importType(std::string_view spelling,
+                                const ModuleInterface &iface) {
+  const Type *type = this->types.parse(spelling);
+  const Type *base = type->getBaseType();
+  if (!base->isStruct() || !base->getModule().empty() ||
+      !iface.findStruct(base->getName().str())) {
+    return type;
   }
 
-  if (type == "char") {
-    return llvm::Type::getInt8Ty(ctx);
+  const Type *qualified = this->types.getQualified(
+      Symbol::intern(iface.getModuleName()), base->getName());
+  for (const Type *t = type; t->isPointer(); t = t->getPointee()) {
+    qualified = this->types.getPointerTo(qualified);
   }
-
-  return llvm::Type::getInt32Ty(ctx);
+  return qualified;
 }
 
-Codegen::Codegen(const std::string &moduleName)
-    : module(std::make_unique<Module>(moduleName, context)),
-      builder(std::make_unique<IRBuilder<>>(context)),
-      currentModuleName(moduleName) {
+Codegen::Codegen(const std::string &moduleName, TypeContext &types)
+    : module(std::make_unique<llvm::Module>(moduleName, context)),
+      builder(std::make_unique<llvm::IRBuilder<>>(context)), types(types),
+      currentModuleName(Symbol::intern(moduleName)) {
   this->pushScope();
   this->currentModuleExports.moduleName = moduleName;
 }
 
-Codegen::~Codegen() { this->scopeStack.clear(); }
+Codegen::~Codegen() { this->bindings.clear(); }
 
 void Codegen::generate(const std::vector<Statement *> &statements) {
   for (auto *stmt : statements) {
@@ -152,52 +241,44 @@ void Codegen::generate(const std::vector<Statement *> &statements) {
   }
 }
 
-std::unique_ptr<Module> Codegen::takeModule() { return std::move(module); }
-
-llvm::Value *Codegen::genExpr(Expr *expr) {
-  if (auto *intLit = dynamic_cast<IntLiteral *>(expr)) {
-    return llvm::ConstantInt::get(getLLVMType("i32", context), intLit->value);
-  } else if (auto *floatLit = dynamic_cast<FloatLiteral *>(expr)) {
-    return llvm::ConstantFP::get(this->getLLVMType("f32", this->context),
-                                 floatLit->value);
-  } else if (auto *boolLit = dynamic_cast<BoolLiteral *>(expr)) {
-    return llvm::ConstantInt::get(this->getLLVMType("bool", this->context),
-                                  boolLit->value);
-  } else if (auto *var = dynamic_cast<Variable *>(expr)) {
-    LocalVar *localVar = this->findVariable(var->name);
+std::unique_ptr<llvm::Module> Codegen::takeModule() {
+  return std::move(module);
+}
 
-    if (localVar->alloca == nullptr) {
-      if (auto *global = this->module->getGlobalVariable(var->name)) {
-        return this->builder->CreateLoad(global->getValueType(), global,
-                                         var->name);
-      }
-      fprintf(stderr, "Error: Global variable '%s' not found in module.\n",
-              var->name.c_str());
-      std::abort();
-    }
+llvm::Value *Codegen::genExpr(Expr *expr) { return this->visitExpr(expr); }
 
-    return this->builder->CreateLoad(localVar->alloca->getAllocatedType(),
-                                     localVar->alloca, var->name);
-  } else if (auto *binExp = dynamic_cast<BinaryExpr *>(expr)) {
-    return this->genBinaryExpr(binExp);
-  } else if (auto *callExp = dynamic_cast<CallExpr *>(expr)) {
-    return this->genCallExpr(callExp);
-  } else if (auto *charLiteral = dynamic_cast<CharLiteral *>(expr)) {
-    return this->genCharLiteral(charLiteral->value);
-  } else if (auto *stringLiteral = dynamic_cast<StrLiteral *>(expr)) {
-    return this->genStringLiteral(stringLiteral->value);
-  } else if (auto *unary = dynamic_cast<UnaryExpr *>(expr)) {
-    return this->genUnaryExpr(unary);
-  } else if (auto *structLit = dynamic_cast<StructLiteral *>(expr)) {
-    return this->genStructLiteral(structLit);
-  } else if (auto *memberAccess = dynamic_cast<MemberAccessExpr *>(expr)) {
-    return this->genMemberAccessExpr(memberAccess);
+llvm::Value *Codegen::visitIntLiteral(IntLiteral *expr) {
+  return llvm::ConstantInt::get(getLLVMType(this->types.getI32()), expr->value);
+}
+
+llvm::Value *Codegen::visitFloatLiteral(FloatLiteral *expr) {
+  return llvm::ConstantFP::get(this->getLLVMType(this->types.getF32()),
+                               expr->value);
+}
+
+llvm::Value *Codegen::visitBoolLiteral(BoolLiteral *expr) {
+  return llvm::ConstantInt::get(this->getLLVMType(this->types.getBool()),
+                                expr->value);
+}
+
+llvm::Value *Codegen::visitVariable(Variable *var) {
+  LocalVar *localVar = this->findVariable(var->name);
+
+  if (localVar->alloca == nullptr && !localVar->isSSA()) {
+    if (auto *global = this->module->getGlobalVariable(var->name.str())) {
+      return this->builder->CreateLoad(global->getValueType(), global,
+                                       var->name.str());
+    }
+    fprintf(stderr, "Error: Global variable '%s' not found in module.\n",
+            var->name.c_str());
+    std::abort();
   }
-  return nullptr;
+
+  return this->readLocal(*localVar, var->name.str());
 }
 
 void Codegen::genVarDecl(VarDecl *varDecl) {
-  llvm::Type *llvmTy = getLLVMType(varDecl->type, context);
+  llvm::Type *llvmTy = this->getLLVMType(varDecl->type);
 
   if (builder->GetInsertBlock() == nullptr) {
     // No active block → global variable
@@ -223,9 +304,9 @@ void Codegen::genVarDecl(VarDecl *varDecl) {
 
     llvm::GlobalVariable *globalVar = new llvm::GlobalVariable(
         *module, llvmTy, false, llvm::GlobalValue::ExternalLinkage, init,
-        varDecl->name);
+        varDecl->name.str());
 
-    if (this->scopeStack.empty()) {
+    if (this->scopeMarks.size() != 1) {
       fprintf(stderr, "Error: No global scope available.\nThis error should "
                       "never happen.\nSomething went terribly wrong.\n");
       std::abort();
@@ -233,8 +314,8 @@ void Codegen::genVarDecl(VarDecl *varDecl) {
 
     // Global varaibles don't have an alloca pointer, findVariable will handle
     // this case.
-    this->scopeStack[0][varDecl->name] = {nullptr, llvmTy, varDecl->type,
-                                          varDecl->isConst};
+    this->addVariable(varDecl->name,
+                      {nullptr, llvmTy, varDecl->type, varDecl->isConst});
   } else {
     // Local variable: ensure inside a function
     llvm::Function *func = builder->GetInsertBlock()->getParent();
@@ -245,6 +326,31 @@ void Codegen::genVarDecl(VarDecl *varDecl) {
       std::abort();
     }
 
+    // Evaluate the initializer before the new binding exists, so that it
+    // sees any variable of the same name this declaration shadows.
+    llvm::Value *initVal = nullptr;
+    if (varDecl->initializer) {
+      initVal = genExpr(varDecl->initializer);
+      if (!initVal) {
+        fprintf(stderr, "Error: Local variable '%s' initializer is invalid.\n",
+                varDecl->name.c_str());
+        std::abort();
+      }
+      initVal = this->convertForStore(initVal, llvmTy);
+    } else {
+      // Declared without a value: start out zeroed, never undef, since the
+      // variable may be passed to a noundef parameter.
+      initVal = llvm::Constant::getNullValue(llvmTy);
+    }
+
+    if (this->canBeSSA(varDecl->name, varDecl->type)) {
+      uint32_t ssaVar = this->declareSSAVariable(varDecl->name, llvmTy);
+      this->writeVariable(ssaVar, builder->GetInsertBlock(), initVal);
+      this->addVariable(varDecl->name, {nullptr, llvmTy, varDecl->type,
+                                        varDecl->isConst, ssaVar});
+      return;
+    }
+
     // Save current insertion point
     llvm::IRBuilder<>::InsertPoint oldIP = builder->saveIP();
 
@@ -252,7 +358,7 @@ void Codegen::genVarDecl(VarDecl *varDecl) {
     llvm::BasicBlock *entry = &func->getEntryBlock();
     builder->SetInsertPoint(entry, entry->begin());
     llvm::AllocaInst *alloca =
-        builder->CreateAlloca(llvmTy, nullptr, varDecl->name);
+        builder->CreateAlloca(llvmTy, nullptr, varDecl->name.str());
 
     this->addVariable(varDecl->name,
                       {alloca, llvmTy, varDecl->type, varDecl->isConst});
@@ -260,102 +366,166 @@ void Codegen::genVarDecl(VarDecl *varDecl) {
     // Restore insertion point
     builder->restoreIP(oldIP);
 
-    // Initialize if initializer exists
-    if (varDecl->initializer) {
-      llvm::Value *initVal = genExpr(varDecl->initializer);
-      if (!initVal) {
-        fprintf(stderr, "Error: Local variable '%s' initializer is invalid.\n",
-                varDecl->name.c_str());
-        std::abort();
-      }
-      builder->CreateStore(initVal, alloca);
-    }
+    builder->CreateStore(initVal, alloca);
   }
 }
 
-void Codegen::genStatement(Statement *stmt) {
-  if (auto *varDecl = dynamic_cast<VarDecl *>(stmt)) {
-    this->genVarDecl(varDecl);
-    return;
-  } else if (auto *funDecl = dynamic_cast<FunctionDecl *>(stmt)) {
-    this->genFunction(funDecl);
-    return;
-  } else if (auto *structDecl = dynamic_cast<StructDecl *>(stmt)) {
-    this->genStructDecl(structDecl);
-    return;
-  } else if (auto *retStmt = dynamic_cast<ReturnStmt *>(stmt)) {
-    this->genReturnStatement(retStmt);
-    return;
-  } else if (auto *exprStmt = dynamic_cast<ExprStmt *>(stmt)) {
-    this->genExpr(exprStmt->expr);
-    return;
-  } else if (auto *ifStmt = dynamic_cast<IfStmt *>(stmt)) {
-    this->genIfStatement(ifStmt);
-    return;
-  } else if (auto *whileStmt = dynamic_cast<WhileStmt *>(stmt)) {
-    this->genWhileStatement(whileStmt);
-    return;
-  } else if (auto *forStmt = dynamic_cast<ForStmt *>(stmt)) {
-    this->genForStatement(forStmt);
-    return;
-  } else if (auto *blockStmt = dynamic_cast<BlockStmt *>(stmt)) {
-    this->genBlockStatement(blockStmt);
-    return;
-  }
-  // ...other statements...
-}
+void Codegen::genStatement(Statement *stmt) { this->visitStmt(stmt); }
 
 llvm::Function *Codegen::genFunction(FunctionDecl *funcDecl) {
+  llvm::TimeTraceScope timeScope("CodegenFunction", [&] {
+    return std::string(this->currentModuleName.str()) + "." +
+           std::string(funcDecl->name.str());
+  });
+
   // Determine return type
-  llvm::Type *retTy = this->getLLVMType(funcDecl->returnType, this->context);
+  llvm::Type *retTy = this->getLLVMType(funcDecl->returnType);
 
   std::vector<llvm::Type *> argTypes;
+  std::vector<const Type *> paramTypes;
   for (auto &arg : funcDecl->params) {
-    argTypes.push_back(this->getLLVMType(arg.second, this->context));
+    argTypes.push_back(this->getLLVMType(arg.second));
+    paramTypes.push_back(arg.second);
   }
 
   llvm::FunctionType *funcType =
       llvm::FunctionType::get(retTy, argTypes, false);
 
   // Name mangling (module_functionName)
-  std::string functionName = funcDecl->name;
+  Symbol functionName = funcDecl->name;
 
   if (!funcDecl->isExternal && funcDecl->isExported &&
       !this->currentModuleName.empty()) {
-    functionName = this->currentModuleName + "_" + funcDecl->name;
+    functionName = Symbol::mangle(this->currentModuleName, functionName);
 
     ExportedFunction exportedFunc;
     exportedFunc.name = funcDecl->name;
-    exportedFunc.params = funcDecl->params;
-    exportedFunc.returnType = funcDecl->returnType;
+    for (const auto &param : funcDecl->params) {
+      exportedFunc.params.push_back({param.first, param.second->str()});
+    }
+    exportedFunc.returnType = funcDecl->returnType->str();
     this->currentModuleExports.functions.push_back(exportedFunc);
   }
 
+  if (!funcDecl->targetClones.empty()) {
+    return this->genTargetClones(funcDecl, funcType, functionName, paramTypes);
+  }
+
   llvm::Function *function =
       llvm::Function::Create(funcType, llvm::Function::ExternalLinkage,
-                             functionName, this->module.get());
+                             functionName.str(), this->module.get());
 
+  // Externs are C functions: what they promise is up to their definition.
   if (funcDecl->isExternal) {
     return function;
   }
 
+  this->addFunctionAttributes(function, paramTypes);
+  for (unsigned idx : funcDecl->restrictParams) {
+    function->addParamAttr(idx, llvm::Attribute::NoAlias);
+  }
+  this->genFunctionBody(funcDecl, function);
+  return function;
+}
+
+void Codegen::addFunctionAttributes(llvm::Function *function,
+                                    llvm::ArrayRef<const Type *> paramTypes) {
+  // Raccoon has no exceptions, and the externs it calls are C.
+  function->addFnAttr(llvm::Attribute::NoUnwind);
+
+  std::vector<llvm::Metadata *> structParams;
+  for (unsigned i = 0; i < paramTypes.size(); i++) {
+    const Type *type = paramTypes[i];
+    if (type->isStruct()) {
+      continue; // aggregates by value may have undef padding
+    }
+    function->addParamAttr(i, llvm::Attribute::NoUndef);
+
+    if (!type->isPointer() || !type->getPointee()->isStruct()) {
+      continue;
+    }
+    auto *structTy = llvm::dyn_cast<llvm::StructType>(
+        this->getLLVMType(type->getPointee()));
+    if (!structTy) {
+      continue; // not a known struct
+    }
+    function->addParamAttr(i, llvm::Attribute::NonNull);
+    structParams.push_back(
+        llvm::ConstantAsMetadata::get(this->builder->getInt32(i)));
+    structParams.push_back(llvm::ConstantAsMetadata::get(
+        llvm::Constant::getNullValue(structTy)));
+  }
+  if (!structParams.empty()) {
+    function->setMetadata(StructParamsMetadata,
+                          llvm::MDNode::get(this->context, structParams));
+  }
+}
+
+void Codegen::addTargetAttributes(llvm::Module &module) {
+  const llvm::DataLayout &layout = module.getDataLayout();
+  for (llvm::Function &function : module) {
+    llvm::MDNode *structParams = function.getMetadata(StructParamsMetadata);
+    if (!structParams) {
+      continue;
+    }
+    for (unsigned i = 0; i + 1 < structParams->getNumOperands(); i += 2) {
+      const llvm::MDOperand &index = structParams->getOperand(i);
+      const llvm::MDOperand &value = structParams->getOperand(i + 1);
+      unsigned idx =
+          llvm::mdconst::extract<llvm::ConstantInt>(index)->getZExtValue();
+      llvm::Type *structTy =
+          llvm::mdconst::extract<llvm::Constant>(value)->getType();
+      if (!structTy->isSized()) {
+        continue; // declared but never defined
+      }
+      function.addDereferenceableParamAttr(
+          idx, layout.getTypeAllocSize(structTy).getFixedValue());
+      function.addParamAttr(
+          idx, llvm::Attribute::getWithAlignment(
+                   function.getContext(), layout.getABITypeAlign(structTy)));
+    }
+    function.setMetadata(StructParamsMetadata, nullptr);
+  }
+}
+
+void Codegen::genFunctionBody(FunctionDecl *funcDecl,
+                              llvm::Function *function) {
+  this->ssaVariables.clear();
+  this->sealedBlocks.clear();
+  this->incompletePhis.clear();
+  AddressTakenFinder finder;
+  finder.visitStmts(funcDecl->body);
+  this->addressTaken = std::move(finder.names);
+
   // Create entry block
   llvm::BasicBlock *entry =
       llvm::BasicBlock::Create(this->context, "entry", function);
   builder->SetInsertPoint(entry);
+  this->sealBlock(entry);
 
   // Map function args to locals
   this->pushScope();
 
   unsigned idx = 0;
   for (auto &arg : function->args()) {
-    arg.setName(funcDecl->params[idx].first);
+    Symbol paramName = funcDecl->params[idx].first;
+    const Type *paramType = funcDecl->params[idx].second;
+    arg.setName(paramName.str());
+    if (this->canBeSSA(paramName, paramType)) {
+      uint32_t ssaVar = this->declareSSAVariable(paramName, arg.getType());
+      this->writeVariable(ssaVar, entry, &arg);
+      this->addVariable(paramName,
+                        {nullptr, arg.getType(), paramType, false, ssaVar});
+      idx++;
+      continue;
+    }
+
     llvm::IRBuilder<> tmpBuilder(&function->getEntryBlock(),
                                  function->getEntryBlock().begin());
     llvm::AllocaInst *alloca =
         tmpBuilder.CreateAlloca(arg.getType(), nullptr, arg.getName());
     builder->CreateStore(&arg, alloca);
-    this->addVariable(arg.getName().str(),
+    this->addVariable(funcDecl->params[idx].first,
                       {alloca, arg.getType(), funcDecl->params[idx].second});
     idx++;
   }
@@ -368,11 +538,105 @@ llvm::Function *Codegen::genFunction(FunctionDecl *funcDecl) {
   this->popScope();
 
   // If function returns void and no explicit return, insert return
-  if (retTy->isVoidTy()) {
+  if (function->getReturnType()->isVoidTy()) {
     builder->CreateRetVoid();
   }
+}
 
-  return function;
+llvm::Function *
+Codegen::genTargetClones(FunctionDecl *funcDecl, llvm::FunctionType *funcType,
+                         Symbol functionName,
+                         llvm::ArrayRef<const Type *> paramTypes) {
+  std::string name(functionName.str());
+
+  std::vector<const CloneFeature *> features;
+  bool hasDefault = false;
+  for (std::string_view target : funcDecl->targetClones) {
+    if (target == "default") {
+      hasDefault = true;
+      continue;
+    }
+    const CloneFeature *feature = std::find_if(
+        std::begin(CloneFeatures), std::end(CloneFeatures),
+        [&](const CloneFeature &f) { return f.name == target; });
+    if (feature == std::end(CloneFeatures)) {
+      fprintf(stderr,
+              "Error: Unknown target '%.*s' in @target_clones of '%s'.\n",
+              static_cast<int>(target.size()), target.data(),
+              funcDecl->name.c_str());
+      std::abort();
+    }
+    features.push_back(feature);
+  }
+  if (!hasDefault) {
+    fprintf(stderr,
+            "Error: @target_clones of '%s' needs a \"default\" target.\n",
+            funcDecl->name.c_str());
+    std::abort();
+  }
+  // Table order is priority order.
+  std::sort(features.begin(), features.end());
+  features.erase(std::unique(features.begin(), features.end()), features.end());
+
+  // Callers, including the clones themselves when they recurse, go through
+  // the ifunc, so it has to exist before the body is generated.
+  llvm::Function *resolver = llvm::Function::Create(
+      llvm::FunctionType::get(this->builder->getPtrTy(), false),
+      llvm::Function::InternalLinkage, name + ".resolver", this->module.get());
+  llvm::GlobalIFunc::create(funcType, 0, llvm::Function::ExternalLinkage, name,
+                            resolver, this->module.get());
+
+  llvm::Function *defaultClone =
+      llvm::Function::Create(funcType, llvm::Function::InternalLinkage,
+                             name + ".default", this->module.get());
+  this->addFunctionAttributes(defaultClone, paramTypes);
+  for (unsigned idx : funcDecl->restrictParams) {
+    defaultClone->addParamAttr(idx, llvm::Attribute::NoAlias);
+  }
+  this->genFunctionBody(funcDecl, defaultClone);
+
+  std::vector<llvm::Function *> clones;
+  for (const CloneFeature *feature : features) {
+    llvm::ValueToValueMapTy vmap;
+    llvm::Function *clone = llvm::CloneFunction(defaultClone, vmap);
+    clone->setName(name + "." + std::string(feature->name));
+    // prepareModule turns this into target-features once the build's own
+    // features are known.
+    clone->addFnAttr("raccoon.clone_features",
+                     "+" + std::string(feature->name));
+    clones.push_back(clone);
+  }
+
+  // Ifunc resolvers run before constructors, so the CPU model has to be
+  // initialized here before it is read.
+  llvm::IRBuilder<> resolverBuilder(
+      llvm::BasicBlock::Create(this->context, "entry", resolver));
+  llvm::Type *i32 = resolverBuilder.getInt32Ty();
+  llvm::FunctionCallee cpuInit = this->module->getOrInsertFunction(
+      "__cpu_indicator_init", resolverBuilder.getVoidTy());
+  resolverBuilder.CreateCall(cpuInit);
+
+  // struct { u32 vendor, type, subtype; u32 features[1]; } __cpu_model;
+  llvm::StructType *cpuModelTy = llvm::StructType::get(
+      this->context, {i32, i32, i32, llvm::ArrayType::get(i32, 1)});
+  llvm::Constant *cpuModel =
+      this->module->getOrInsertGlobal("__cpu_model", cpuModelTy);
+  llvm::Value *cpuFeatures = resolverBuilder.CreateLoad(
+      i32,
+      resolverBuilder.CreateConstInBoundsGEP2_32(cpuModelTy, cpuModel, 0, 3),
+      "cpufeatures");
+
+  llvm::Value *chosen = defaultClone;
+  for (size_t i = 0; i < clones.size(); i++) {
+    llvm::Value *bit = resolverBuilder.CreateAnd(
+        cpuFeatures, resolverBuilder.getInt32(1u << features[i]->bit));
+    llvm::Value *supported =
+        resolverBuilder.CreateICmpNE(bit, resolverBuilder.getInt32(0));
+    chosen = resolverBuilder.CreateSelect(supported, clones[i], chosen);
+  }
+  resolverBuilder.CreateRet(chosen);
+
+  return defaultClone;
 }
 
 void Codegen::genReturnStatement(ReturnStmt *stmt) {
@@ -392,9 +656,28 @@ void Codegen::genReturnStatement(ReturnStmt *stmt) {
 
 llvm::Value *Codegen::genBinaryExpr(BinaryExpr *expr) {
   if (expr->op == TokenType::Equal) {
+    if (auto *var = llvm::dyn_cast<Variable>(expr->left)) {
+      LocalVar *localVar = this->findVariable(var->name);
+      if (localVar->isSSA()) {
+        if (localVar->isConst) {
+          fprintf(stderr, "Error: Cannot assign to constant variable '%s'.\n",
+                  var->name.c_str());
+          std::abort();
+        }
+        uint32_t ssaVar = localVar->ssaVar;
+        llvm::Value *rhsVal =
+            this->convertForStore(genExpr(expr->right), localVar->type);
+        this->writeVariable(ssaVar, builder->GetInsertBlock(), rhsVal);
+        return rhsVal;
+      }
+    }
+
     // left must be lvalue
     llvm::Value *lhsPtr = genExprLValue(expr->left);
     llvm::Value *rhsVal = genExpr(expr->right);
+    if (auto *alloca = llvm::dyn_cast_or_null<llvm::AllocaInst>(lhsPtr)) {
+      rhsVal = this->convertForStore(rhsVal, alloca->getAllocatedType());
+    }
     return builder->CreateStore(rhsVal, lhsPtr);
   }
 
@@ -434,8 +717,7 @@ llvm::Value *Codegen::genBinaryExpr(BinaryExpr *expr) {
 
   bool isFloat = lhs->getType()->isFloatingPointTy();
 
-  std::string lhsTypeStr = this->getExprTypeStr(expr->left);
-  bool isUnsigned = this->isUnsignedType(lhsTypeStr);
+  bool isUnsigned = this->getExprType(expr->left)->isUnsigned();
 
   switch (expr->op) {
   case TokenType::Plus: {
@@ -589,9 +871,11 @@ void Codegen::genIfStatement(IfStmt *stmt) {
 
   if (elseBB) {
     this->builder->CreateCondBr(condVal, thenBB, elseBB);
+    this->sealBlock(elseBB);
   } else {
     this->builder->CreateCondBr(condVal, thenBB, mergeBB);
   }
+  this->sealBlock(thenBB);
 
   // THEN block
   this->builder->SetInsertPoint(thenBB);
@@ -616,6 +900,7 @@ void Codegen::genIfStatement(IfStmt *stmt) {
     }
   }
 
+  this->sealBlock(mergeBB);
   this->builder->SetInsertPoint(mergeBB);
 }
 
@@ -645,32 +930,41 @@ void Codegen::genWhileStatement(WhileStmt *stmt) {
   }
 
   this->builder->CreateCondBr(condVal, loopBB, afterBB);
+  this->sealBlock(loopBB);
+  this->sealBlock(afterBB);
 
   // Loop body
   this->builder->SetInsertPoint(loopBB);
   for (auto *s : stmt->body) {
     this->genStatement(s);
   }
-  this->builder->CreateBr(condBB);
+  if (!this->builder->GetInsertBlock()->getTerminator()) {
+    this->builder->CreateBr(condBB);
+  }
+  // The back edge is in place, so the header's predecessors are known.
+  this->sealBlock(condBB);
 
   // continue after loop
   this->builder->SetInsertPoint(afterBB);
 }
 
 llvm::Value *Codegen::genCallExpr(CallExpr *expr) {
-  if (expr->name == "malloc") {
+  static const Symbol mallocSymbol = Symbol::intern("malloc");
+  static const Symbol freeSymbol = Symbol::intern("free");
+
+  if (expr->name == mallocSymbol) {
     if (expr->args.size() != 1) {
       fprintf(stderr,
               "Error: malloc<T>(count) requires exactly one argument.\n");
       std::abort();
     }
 
-    if (expr->type.empty()) {
+    if (!expr->type) {
       fprintf(stderr, "Error: malloc requires a type parameter.\n");
       std::abort();
     }
 
-    llvm::Type *elemTy = this->getLLVMType(expr->type, this->context);
+    llvm::Type *elemTy = this->getLLVMType(expr->type);
     llvm::Value *countVal = this->genExpr(expr->args[0]);
 
     llvm::Value *elemSize = builder->CreateIntCast(
@@ -703,7 +997,7 @@ llvm::Value *Codegen::genCallExpr(CallExpr *expr) {
                                   "mallocCast");
   }
 
-  if (expr->name == "free") {
+  if (expr->name == freeSymbol) {
     if (expr->args.size() != 1) {
       fprintf(stderr, "Error: free requires exactly one argument.\n");
       std::abort();
@@ -726,8 +1020,6 @@ llvm::Value *Codegen::genCallExpr(CallExpr *expr) {
     return builder->CreateCall(freeFunc, {casted});
   }
 
-  std::string functionName = expr->name;
-
   if (!expr->moduleName.empty()) {
     // Qualified call: module.function
     auto it = this->importedModules.find(expr->moduleName);
@@ -737,62 +1029,38 @@ llvm::Value *Codegen::genCallExpr(CallExpr *expr) {
       std::abort();
     }
 
-    const ExportedFunction *exportedFunc = it->second.findFunction(expr->name);
+    const ModuleInterface &iface = *it->second;
+    const racm::FunctionRecord *exportedFunc =
+        iface.findFunction(expr->name.str());
     if (!exportedFunc) {
       fprintf(stderr, "Error: Function '%s' not found in module '%s'.\n",
               expr->name.c_str(), expr->moduleName.c_str());
       std::abort();
     }
 
-    functionName = expr->moduleName + "_" + expr->name;
+    Symbol functionName = Symbol::mangle(expr->moduleName, expr->name);
 
-    llvm::Function *callee = this->module->getFunction(functionName);
+    llvm::Function *callee = this->module->getFunction(functionName.str());
     if (!callee) {
       std::vector<llvm::Type *> paramTypes;
-      for (const auto &param : exportedFunc->params) {
-        std::string paramType = param.second;
-
-        size_t ptrCount = 0;
-        while (!paramType.empty() && paramType.back() == '*') {
-          paramType.pop_back();
-          ptrCount++;
-        }
-
-        const ExportedStruct *exportedStruct = it->second.findStruct(paramType);
-        if (exportedStruct) {
-          paramType = it->second.moduleName + "." + paramType;
-        }
-
-        for (size_t i = 0; i < ptrCount; i++) {
-          paramType += "*";
-        }
-
-        paramTypes.push_back(this->getLLVMType(paramType, this->context));
-      }
-
-      std::string returnType = exportedFunc->returnType;
-
-      size_t ptrCount = 0;
-      while (!returnType.empty() && returnType.back() == '*') {
-        returnType.pop_back();
-        ptrCount++;
-      }
-
-      const ExportedStruct *exportedStruct = it->second.findStruct(returnType);
-      if (exportedStruct) {
-        returnType = it->second.moduleName + "." + returnType;
+      std::vector<const Type *> sourceParamTypes;
+      for (const auto &param : iface.getParams(*exportedFunc)) {
+        const Type *paramType =
+            this->importType(iface.getString(param.type), iface);
+        paramTypes.push_back(this->getLLVMType(paramType));
+        sourceParamTypes.push_back(paramType);
       }
 
-      for (size_t i = 0; i < ptrCount; i++) {
-        returnType += "*";
-      }
+      const Type *returnType =
+          this->importType(iface.getString(exportedFunc->returnType), iface);
 
-      llvm::Type *returnTypeLLVM = this->getLLVMType(returnType, this->context);
+      llvm::Type *returnTypeLLVM = this->getLLVMType(returnType);
       llvm::FunctionType *funcType =
           llvm::FunctionType::get(returnTypeLLVM, paramTypes, false);
 
       callee = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage,
-                                      functionName, this->module.get());
+                                      functionName.str(), this->module.get());
+      this->addFunctionAttributes(callee, sourceParamTypes);
     }
 
     std::vector<llvm::Value *> args;
@@ -809,8 +1077,13 @@ llvm::Value *Codegen::genCallExpr(CallExpr *expr) {
     return this->builder->CreateCall(
         callee, args, callee->getReturnType()->isVoidTy() ? "" : "calltmp");
   }
-  // Unqualified call
-  llvm::Function *callee = this->module->getFunction(expr->name);
+  // Unqualified call. @target_clones functions are called through their ifunc.
+  llvm::FunctionCallee callee = this->module->getFunction(expr->name.str());
+  if (!callee) {
+    if (auto *ifunc = this->module->getNamedIFunc(expr->name.str())) {
+      callee = {llvm::cast<llvm::FunctionType>(ifunc->getValueType()), ifunc};
+    }
+  }
   if (!callee) {
     fprintf(stderr, "Error: Unknown function '%s',\n", expr->name.c_str());
     std::abort();
@@ -828,10 +1101,11 @@ llvm::Value *Codegen::genCallExpr(CallExpr *expr) {
   }
 
   return this->builder->CreateCall(
-      callee, args, callee->getReturnType()->isVoidTy() ? "" : "calltmp");
+      callee, args,
+      callee.getFunctionType()->getReturnType()->isVoidTy() ? "" : "calltmp");
 }
 
-llvm::Value *Codegen::genStringLiteral(const std::string &str) {
+llvm::Value *Codegen::genStringLiteral(std::string_view str) {
   llvm::Constant *strConst =
       llvm::ConstantDataArray::getString(this->context, str);
 
@@ -854,11 +1128,11 @@ llvm::Value *Codegen::genCharLiteral(char c) {
 llvm::Value *Codegen::genUnaryExpr(UnaryExpr *expr) {
   switch (expr->op) {
   case TokenType::Ampersand: { // &var
-    if (auto *var = dynamic_cast<Variable *>(expr->operand)) {
+    if (auto *var = llvm::dyn_cast<Variable>(expr->operand)) {
       LocalVar *localVar = this->findVariable(var->name);
 
       if (localVar->alloca == nullptr) {
-        if (auto *global = this->module->getGlobalVariable(var->name)) {
+        if (auto *global = this->module->getGlobalVariable(var->name.str())) {
           return global;
         }
         fprintf(stderr, "Error: Global variable '%s' not found.\n",
@@ -869,19 +1143,18 @@ llvm::Value *Codegen::genUnaryExpr(UnaryExpr *expr) {
       return localVar->alloca;
     }
   case TokenType::Star: { // *ptr
-    if (auto *var = dynamic_cast<Variable *>(expr->operand)) {
+    if (auto *var = llvm::dyn_cast<Variable>(expr->operand)) {
       LocalVar *localVar = this->findVariable(var->name);
 
-      std::string pointedToTypeStr = this->getPointedToType(localVar->typeStr);
-      if (pointedToTypeStr.empty()) {
+      const Type *pointedTo = localVar->sourceType->getPointee();
+      if (!pointedTo) {
         fprintf(stderr,
                 "Error: Attempt to dereference non-pointer variable '%s'.\n",
                 var->name.c_str());
         std::abort();
       }
 
-      llvm::Type *pointedToType =
-          this->getLLVMType(pointedToTypeStr, this->context);
+      llvm::Type *pointedToType = this->getLLVMType(pointedTo);
       llvm::Value *ptrVal = this->genExpr(expr->operand);
 
       return this->builder->CreateLoad(pointedToType, ptrVal, "deref");
@@ -929,11 +1202,16 @@ llvm::Value *Codegen::genUnaryExpr(UnaryExpr *expr) {
 }
 
 llvm::Value *Codegen::genLValue(Expr *expr) {
-  if (auto *var = dynamic_cast<Variable *>(expr)) {
+  if (auto *var = llvm::dyn_cast<Variable>(expr)) {
     LocalVar *localVar = this->findVariable(var->name);
 
+    if (localVar->isSSA()) {
+      fprintf(stderr, "Error: Local variable '%s' has no address.\n",
+              var->name.c_str());
+      std::abort();
+    }
     if (localVar->alloca == nullptr) {
-      if (auto *global = this->module->getGlobalVariable(var->name)) {
+      if (auto *global = this->module->getGlobalVariable(var->name.str())) {
         return global;
       }
       fprintf(stderr, "Error: Global variable '%s' not found.\n",
@@ -942,7 +1220,7 @@ llvm::Value *Codegen::genLValue(Expr *expr) {
     }
 
     return localVar->alloca;
-  } else if (auto *unary = dynamic_cast<UnaryExpr *>(expr)) {
+  } else if (auto *unary = llvm::dyn_cast<UnaryExpr>(expr)) {
     if (unary->op == TokenType::Star) {
       llvm::Value *ptr = this->genExpr(unary->operand);
       if (!ptr) {
@@ -953,101 +1231,74 @@ llvm::Value *Codegen::genLValue(Expr *expr) {
     }
   }
 
-  else if (auto *memberAccess = dynamic_cast<MemberAccessExpr *>(expr)) {
+  else if (auto *memberAccess = llvm::dyn_cast<MemberAccessExpr>(expr)) {
     llvm::Value *structPtr = nullptr;
     llvm::StructType *structType = nullptr;
-    std::string structTypeName;
+    const Type *structTy = nullptr;
 
     // (p.x)
-    if (auto *var = dynamic_cast<Variable *>(memberAccess->object)) {
+    if (auto *var = llvm::dyn_cast<Variable>(memberAccess->object)) {
       LocalVar *localVar = this->findVariable(var->name);
-      structTypeName = localVar->typeStr;
+      structTy = localVar->sourceType;
 
-      if (!structTypeName.empty() && structTypeName.back() == '*') {
+      if (structTy->isPointer()) {
         // Pointer to struct
-        structTypeName = structTypeName.substr(0, structTypeName.size() - 1);
-        structPtr =
-            this->builder->CreateLoad(localVar->alloca->getAllocatedType(),
-                                      localVar->alloca, var->name + "_load");
+        structTy = structTy->getPointee();
+        structPtr = this->readLocal(
+            *localVar, llvm::Twine(var->name.str()) + "_load");
       } else {
         // Direct struct
         structPtr = localVar->alloca;
       }
 
-      std::string mangledName = structTypeName;
-      size_t dotPos = structTypeName.find('.');
-      if (dotPos != std::string::npos) {
-        // Convert "module.Type" to "module_Type"
-        std::string moduleName = structTypeName.substr(0, dotPos);
-        std::string typeName = structTypeName.substr(dotPos + 1);
-        mangledName = moduleName + "_" + typeName;
-      } else if (!this->currentModuleName.empty()) {
-        std::string localMangled =
-            this->currentModuleName + "_" + structTypeName;
-        if (this->structTypes.find(localMangled) != this->structTypes.end()) {
-          mangledName = localMangled;
-        }
-      }
+      Symbol mangledName = this->resolveStructName(structTy);
 
       auto it = this->structTypes.find(mangledName);
       if (it == this->structTypes.end()) {
         fprintf(stderr, "Error: Unknown struct type '%s' in member access.\n",
-                structTypeName.c_str());
+                structTy->str().c_str());
         std::abort();
       }
       structType = it->second;
 
       int fieldIndex = this->getFieldIndex(mangledName, memberAccess->field);
-      return this->builder->CreateStructGEP(structType, structPtr, fieldIndex,
-                                            memberAccess->field + "_ptr");
+      return this->builder->CreateStructGEP(
+          structType, structPtr, fieldIndex,
+          llvm::Twine(memberAccess->field.str()) + "_ptr");
     }
     // ((*ptr).x)
-    else if (auto *unary = dynamic_cast<UnaryExpr *>(memberAccess->object)) {
+    else if (auto *unary = llvm::dyn_cast<UnaryExpr>(memberAccess->object)) {
       if (unary->op == TokenType::Star) {
-        if (auto *ptrVar = dynamic_cast<Variable *>(unary->operand)) {
+        if (auto *ptrVar = llvm::dyn_cast<Variable>(unary->operand)) {
           LocalVar *localVar = this->findVariable(ptrVar->name);
 
-          structTypeName = this->getPointedToType(localVar->typeStr);
-          if (structTypeName.empty()) {
+          structTy = localVar->sourceType->getPointee();
+          if (!structTy) {
             fprintf(
                 stderr,
                 "Error: Cannot dereference non-pointer in member access.\n");
             std::abort();
           }
 
-          std::string mangledName = structTypeName;
-          size_t dotPos = structTypeName.find('.');
-          if (dotPos != std::string::npos) {
-            // Convert "module.Type" to "module_Type"
-            std::string moduleName = structTypeName.substr(0, dotPos);
-            std::string typeName = structTypeName.substr(dotPos + 1);
-            mangledName = moduleName + "_" + typeName;
-          } else if (!this->currentModuleName.empty()) {
-            std::string localMangled =
-                this->currentModuleName + "_" + structTypeName;
-            if (this->structTypes.find(localMangled) !=
-                this->structTypes.end()) {
-              mangledName = localMangled;
-            }
-          }
+          Symbol mangledName = this->resolveStructName(structTy);
 
           auto it = this->structTypes.find(mangledName);
           if (it == this->structTypes.end()) {
             fprintf(stderr,
                     "Error: Unknown struct type '%s' in member access.\n",
-                    structTypeName.c_str());
+                    structTy->str().c_str());
             std::abort();
           }
           structType = it->second;
 
-          structPtr = this->builder->CreateLoad(
-              localVar->alloca->getAllocatedType(), localVar->alloca,
-              ptrVar->name + "_load");
+          structPtr = this->readLocal(
+              *localVar, llvm::Twine(ptrVar->name.str()) + "_load");
 
           int fieldIndex =
               this->getFieldIndex(mangledName, memberAccess->field);
           return this->builder->CreateStructGEP(
-              structType, structPtr, fieldIndex, memberAccess->field + "_ptr");
+              structType, structPtr, fieldIndex,
+              llvm::Twine(memberAccess->field.str()) + "_ptr");
         } else {
           fprintf(stderr, "Error: Complex dereference in member access lvalue "
                           "not yet supported.\n");
@@ -1071,7 +1322,7 @@ llvm::Value *Codegen::genLValue(Expr *expr) {
 }
 
 llvm::Value *Codegen::genExprLValue(Expr *expr) {
-  if (auto *var = dynamic_cast<Variable *>(expr)) {
+  if (auto *var = llvm::dyn_cast<Variable>(expr)) {
     LocalVar *localVar = this->findVariable(var->name);
 
     if (localVar->isConst) {
@@ -1081,7 +1332,7 @@ llvm::Value *Codegen::genExprLValue(Expr *expr) {
     }
 
     if (localVar->alloca == nullptr) {
-      if (auto *global = this->module->getGlobalVariable(var->name)) {
+      if (auto *global = this->module->getGlobalVariable(var->name.str())) {
         fprintf(stderr, "Error: Global variable '%s' not found.\n",
                 var->name.c_str());
         std::abort();
@@ -1089,11 +1340,11 @@ llvm::Value *Codegen::genExprLValue(Expr *expr) {
     }
 
     return localVar->alloca;
-  } else if (auto *un = dynamic_cast<UnaryExpr *>(expr)) {
+  } else if (auto *un = llvm::dyn_cast<UnaryExpr>(expr)) {
     if (un->op == TokenType::Star) {
       return this->genExpr(un->operand);
     }
-  } else if (auto *memberAccess = dynamic_cast<MemberAccessExpr *>(expr)) {
+  } else if (auto *memberAccess = llvm::dyn_cast<MemberAccessExpr>(expr)) {
     return this->genLValue(memberAccess);
   }
   fprintf(stderr, "Error: Expression cannot be used as lvalue.\n");
@@ -1149,67 +1400,222 @@ void Codegen::genForStatement(ForStmt *stmt) {
   } else {
     this->builder->CreateBr(bodyBB);
   }
+  this->sealBlock(bodyBB);
+  this->sealBlock(afterBB);
 
   this->builder->SetInsertPoint(bodyBB);
   for (auto *s : stmt->body) {
     this->genStatement(s);
   }
-  this->builder->CreateBr(incBB);
+  if (!this->builder->GetInsertBlock()->getTerminator()) {
+    this->builder->CreateBr(incBB);
+  }
+  this->sealBlock(incBB);
 
   this->builder->SetInsertPoint(incBB);
   if (stmt->increment) {
     this->genExpr(stmt->increment);
   }
   this->builder->CreateBr(condBB);
+  // The back edge is in place, so the header's predecessors are known.
+  this->sealBlock(condBB);
 
   this->builder->SetInsertPoint(afterBB);
 
   this->popScope();
 }
 
+// MARK: SSA locals
+
+uint32_t Codegen::declareSSAVariable(Symbol name, llvm::Type *type) {
+  this->ssaVariables.push_back({name, type, {}});
+  return static_cast<uint32_t>(this->ssaVariables.size() - 1);
+}
+
+void Codegen::writeVariable(uint32_t var, llvm::BasicBlock *block,
+                            llvm::Value *value) {
+  this->ssaVariables[var].defs[block] = value;
+}
+
+llvm::Value *Codegen::readVariable(uint32_t var, llvm::BasicBlock *block) {
+  auto it = this->ssaVariables[var].defs.find(block);
+  if (it != this->ssaVariables[var].defs.end()) {
+    return it->second;
+  }
+  return this->readVariableRecursive(var, block);
+}
+
+llvm::Value *Codegen::readVariableRecursive(uint32_t var,
+                                            llvm::BasicBlock *block) {
+  const SSAVariable &variable = this->ssaVariables[var];
+  llvm::Value *value;
+  if (!this->sealedBlocks.count(block)) {
+    // More predecessors may still be added; fill the phi in when sealed.
+    llvm::IRBuilder<> phiBuilder(block, block->begin());
+    llvm::PHINode *phi = phiBuilder.CreatePHI(variable.type, 0,
+                                              variable.name.str());
+    this->incompletePhis[block].push_back({var, phi});
+    value = phi;
+  } else if (llvm::BasicBlock *pred = block->getSinglePredecessor()) {
+    value = this->readVariable(var, pred);
+  } else if (llvm::pred_empty(block)) {
+    // Unreachable, or read before any assignment.
+    value = llvm::UndefValue::get(variable.type);
+  } else {
+    // Record the phi before visiting the predecessors to break cycles.
+    llvm::IRBuilder<> phiBuilder(block, block->begin());
+    llvm::PHINode *phi = phiBuilder.CreatePHI(variable.type, 0,
+                                              variable.name.str());
+    this->writeVariable(var, block, phi);
+    value = this->addPhiOperands(var, phi);
+  }
+  this->writeVariable(var, block, value);
+  return value;
+}
+
+llvm::Value *Codegen::addPhiOperands(uint32_t var, llvm::PHINode *phi) {
+  llvm::SmallVector<llvm::BasicBlock *, 4> preds(
+      llvm::predecessors(phi->getParent()));
+  for (llvm::BasicBlock *pred : preds) {
+    phi->addIncoming(this->readVariable(var, pred), pred);
+  }
+  return this->tryRemoveTrivialPhi(phi);
+}
+
+llvm::Value *Codegen::tryRemoveTrivialPhi(llvm::PHINode *phi) {
+  llvm::Value *same = nullptr;
+  for (llvm::Value *op : phi->incoming_values()) {
+    if (op == same || op == phi) {
+      continue;
+    }
+    if (same) {
+      return phi; // merges at least two values
+    }
+    same = op;
+  }
+  if (!same) {
+    same = llvm::UndefValue::get(phi->getType());
+  }
+
+  // Phis that used this one may have become trivial in turn. Weak handles,
+  // because removing one of them can remove the next.
+  llvm::SmallVector<llvm::WeakVH, 8> users;
+  for (llvm::User *user : phi->users()) {
+    if (user != phi && llvm::isa<llvm::PHINode>(user)) {
+      users.push_back(user);
+    }
+  }
+  phi->replaceAllUsesWith(same);
+  phi->eraseFromParent();
+
+  for (llvm::WeakVH &user : users) {
+    if (auto *userPhi = llvm::dyn_cast_or_null<llvm::PHINode>(user)) {
+      this->tryRemoveTrivialPhi(userPhi);
+    }
+  }
+  return same;
+}
+
+void Codegen::sealBlock(llvm::BasicBlock *block) {
+  auto it = this->incompletePhis.find(block);
+  if (it != this->incompletePhis.end()) {
+    std::vector<std::pair<uint32_t, llvm::PHINode *>> phis =
+        std::move(it->second);
+    this->incompletePhis.erase(it);
+    for (auto &[var, phi] : phis) {
+      this->addPhiOperands(var, phi);
+    }
+  }
+  this->sealedBlocks.insert(block);
+}
+
+llvm::Value *Codegen::readLocal(const LocalVar &var, const llvm::Twine &name) {
+  if (var.isSSA()) {
+    return this->readVariable(var.ssaVar, this->builder->GetInsertBlock());
+  }
+  return this->builder->CreateLoad(var.alloca->getAllocatedType(), var.alloca,
+                                   name);
+}
+
+llvm::Value *Codegen::convertForStore(llvm::Value *value, llvm::Type *type) {
+  llvm::Type *valueType = value->getType();
+  if (valueType == type) {
+    return value;
+  }
+  if (valueType->isIntegerTy() && type->isIntegerTy()) {
+    return castIntegerIfNeeded(this->builder.get(), value, valueType, type);
+  }
+  if (valueType->isIntegerTy() && type->isFloatingPointTy()) {
+    return this->builder->CreateSIToFP(value, type, "inttofp");
+  }
+  if (valueType->isFloatingPointTy() && type->isFloatingPointTy()) {
+    return this->builder->CreateFPCast(value, type, "fpcast");
+  }
+  return value;
+}
+
 // MARK: Scope mgmt
 
 void Codegen::pushScope() {
-  this->scopeStack.push_back(std::unordered_map<std::string, LocalVar>());
+  this->scopeMarks.push_back(static_cast<uint32_t>(this->bindings.size()));
 }
 
 void Codegen::popScope() {
-  if (this->scopeStack.empty()) {
+  if (this->scopeMarks.empty()) {
     fprintf(stderr, "Error: Attempted to pop from an empty scope stack.\n");
     std::abort();
   }
-  this->scopeStack.pop_back();
-}
 
-LocalVar *Codegen::findVariable(const std::string &name) {
-  // note to self: top of the stack is the innermost scope
-  // i sometimes forget this because im big dumb
-  for (auto it = this->scopeStack.rbegin(); it != this->scopeStack.rend();
-       ++it) {
-    auto varIt = it->find(name);
-    if (varIt != it->end()) {
-      return &varIt->second;
+  // Unwind this scope's bindings, newest first, so each name goes back to
+  // whatever it shadowed. The vectors keep their capacity for the next scope.
+  uint32_t mark = this->scopeMarks.back();
+  this->scopeMarks.pop_back();
+  for (uint32_t idx = this->bindings.size(); idx-- > mark;) {
+    const Binding &binding = this->bindings[idx];
+    if (binding.shadowed == NoBinding) {
+      this->innermost.erase(binding.name);
+    } else {
+      this->innermost[binding.name] = binding.shadowed;
     }
   }
+  this->bindings.resize(mark);
+}
+
+LocalVar *Codegen::findVariable(Symbol name) {
+  auto it = this->innermost.find(name);
+  if (it != this->innermost.end()) {
+    return &this->bindings[it->second].var;
+  }
 
   fprintf(stderr, "Error: Undefined variable '%s'.\n", name.c_str());
   std::abort();
 }
 
-void Codegen::addVariable(const std::string &name, const LocalVar &var) {
-  if (this->scopeStack.empty()) {
+void Codegen::addVariable(Symbol name, const LocalVar &var) {
+  if (this->scopeMarks.empty()) {
     fprintf(stderr, "Error: No active scope to add the variable '%s'.\n",
             name.c_str());
     std::abort();
   }
 
-  this->scopeStack.back()[name] = var;
+  uint32_t idx = static_cast<uint32_t>(this->bindings.size());
+  auto [it, inserted] = this->innermost.try_emplace(name, idx);
+  if (!inserted) {
+    if (it->second >= this->scopeMarks.back()) {
+      // Redeclared in the same scope: replace the binding in place.
+      this->bindings[it->second].var = var;
+      return;
+    }
+    this->bindings.push_back({name, it->second, var});
+    it->second = idx;
+    return;
+  }
+  this->bindings.push_back({name, NoBinding, var});
 }
 
 // MARK: Structs
 
-int Codegen::getFieldIndex(const std::string &structName,
-                           const std::string &fieldName) {
+int Codegen::getFieldIndex(Symbol structName, Symbol fieldName) {
   auto it = this->structFieldMetadata.find(structName);
   if (it == this->structFieldMetadata.end()) {
     fprintf(stderr, "Error: Unknown struct type '%s'.\n", structName.c_str());
@@ -1229,9 +1635,9 @@ int Codegen::getFieldIndex(const std::string &structName,
 }
 
 void Codegen::genStructDecl(StructDecl *structDecl) {
-  std::string mangledName = structDecl->name;
+  Symbol mangledName = structDecl->name;
   if (!this->currentModuleName.empty()) {
-    mangledName = this->currentModuleName + "_" + structDecl->name;
+    mangledName = Symbol::mangle(this->currentModuleName, mangledName);
   }
 
   if (this->structTypes.find(mangledName) != this->structTypes.end()) {
@@ -1242,32 +1648,36 @@ void Codegen::genStructDecl(StructDecl *structDecl) {
 
   std::vector<llvm::Type *> fieldTypes;
   for (const auto &field : structDecl->fields) {
-    llvm::Type *fieldType = this->getLLVMType(field.second, this->context);
+    llvm::Type *fieldType = this->getLLVMType(field.second);
     if (!fieldType) {
       fprintf(
           stderr, "Error: Invalid type '%s' for field '%s' in struct '%s'.\n",
-          field.second.c_str(), field.first.c_str(), structDecl->name.c_str());
+          field.second->str().c_str(), field.first.c_str(),
+          structDecl->name.c_str());
       std::abort();
     }
     fieldTypes.push_back(fieldType);
   }
 
   llvm::StructType *structType =
-      llvm::StructType::create(this->context, fieldTypes, mangledName);
+      llvm::StructType::create(this->context, fieldTypes, mangledName.str());
 
   this->structTypes[mangledName] = structType;
 
-  this->structFieldMetadata[mangledName] = structDecl->fields;
+  this->structFieldMetadata[mangledName].assign(structDecl->fields.begin(),
+                                                structDecl->fields.end());
 
   if (structDecl->isExported) {
     ExportedStruct exportedStruct;
     exportedStruct.name = structDecl->name;
-    exportedStruct.fields = structDecl->fields;
+    for (const auto &field : structDecl->fields) {
+      exportedStruct.fields.push_back({field.first, field.second->str()});
+    }
     this->currentModuleExports.structs.push_back(exportedStruct);
   }
 }
 llvm::Value *Codegen::genStructLiteral(StructLiteral *expr) {
-  std::string structName;
+  Symbol structName;
   if (!expr->moduleName.empty()) {
     auto it = this->importedModules.find(expr->moduleName);
     if (it == this->importedModules.end()) {
@@ -1276,19 +1686,19 @@ llvm::Value *Codegen::genStructLiteral(StructLiteral *expr) {
       std::abort();
     }
 
-    const ExportedStruct *exportedStruct =
-        it->second.findStruct(expr->typeName);
-    if (!exportedStruct) {
+    const ModuleInterface &iface = *it->second;
+    if (!iface.findStruct(expr->typeName.str())) {
       fprintf(stderr, "Error: Struct '%s' not found in module '%s'.\n",
               expr->typeName.c_str(), expr->moduleName.c_str());
       std::abort();
     }
 
-    structName = it->second.moduleName + "_" + expr->typeName;
+    structName = Symbol::mangle(Symbol::intern(iface.getModuleName()),
+                                expr->typeName);
   } else {
     structName = expr->typeName;
     if (!this->currentModuleName.empty()) {
-      structName = this->currentModuleName + "_" + expr->typeName;
+      structName = Symbol::mangle(this->currentModuleName, structName);
     }
   }
 
@@ -1333,7 +1743,7 @@ llvm::Value *Codegen::genStructLiteral(StructLiteral *expr) {
   }
 
   for (const auto &fieldInit : expr->fields) {
-    const std::string &fieldName = fieldInit.first;
+    Symbol fieldName = fieldInit.first;
     Expr *fieldValue = fieldInit.second;
 
     int fieldIndex = this->getFieldIndex(structName, fieldName);
@@ -1346,7 +1756,7 @@ llvm::Value *Codegen::genStructLiteral(StructLiteral *expr) {
     }
 
     llvm::Value *fieldPtr = this->builder->CreateStructGEP(
-        structType, alloca, fieldIndex, fieldName + "_ptr");
+        structType, alloca, fieldIndex, llvm::Twine(fieldName.str()) + "_ptr");
 
     this->builder->CreateStore(value, fieldPtr);
   }
@@ -1357,85 +1767,59 @@ llvm::Value *Codegen::genStructLiteral(StructLiteral *expr) {
 llvm::Value *Codegen::genMemberAccessExpr(MemberAccessExpr *expr) {
   llvm::Value *structPtr = nullptr;
   llvm::StructType *structType = nullptr;
-  std::string structTypeName;
+  const Type *structTy = nullptr;
+  Symbol mangledName;
 
-  if (auto *var = dynamic_cast<Variable *>(expr->object)) {
+  if (auto *var = llvm::dyn_cast<Variable>(expr->object)) {
     LocalVar *localVar = this->findVariable(var->name);
 
-    structTypeName = localVar->typeStr;
+    structTy = localVar->sourceType;
 
-    if (!structTypeName.empty() && structTypeName.back() == '*') {
+    if (structTy->isPointer()) {
       // It's a pointer to struct, load it
-      structTypeName = structTypeName.substr(0, structTypeName.size() - 1);
-      structPtr =
-          this->builder->CreateLoad(localVar->alloca->getAllocatedType(),
-                                    localVar->alloca, var->name + "_load");
+      structTy = structTy->getPointee();
+      structPtr = this->readLocal(
+          *localVar, llvm::Twine(var->name.str()) + "_load");
     } else {
       // It's a direct struct value, get its address
       structPtr = localVar->alloca;
     }
 
-    std::string mangledName = structTypeName;
-    size_t dotPos = structTypeName.find('.');
-    if (dotPos != std::string::npos) {
-      // Convert "module.Type" to "module_Type"
-      std::string moduleName = structTypeName.substr(0, dotPos);
-      std::string typeName = structTypeName.substr(dotPos + 1);
-      mangledName = moduleName + "_" + typeName;
-    } else if (!this->currentModuleName.empty()) {
-      std::string localMangled = this->currentModuleName + "_" + structTypeName;
-      if (this->structTypes.find(localMangled) != this->structTypes.end()) {
-        mangledName = localMangled;
-      }
-    }
+    mangledName = this->resolveStructName(structTy);
 
     auto it = this->structTypes.find(mangledName);
     if (it == this->structTypes.end()) {
       fprintf(stderr, "Error: Unknown struct type '%s' in member access.\n",
-              structTypeName.c_str());
+              structTy->str().c_str());
       std::abort();
     }
     structType = it->second;
 
-  } else if (auto *unary = dynamic_cast<UnaryExpr *>(expr->object)) {
+  } else if (auto *unary = llvm::dyn_cast<UnaryExpr>(expr->object)) {
     // Handle (*ptr).x case
     if (unary->op == TokenType::Star) {
-      if (auto *ptrVar = dynamic_cast<Variable *>(unary->operand)) {
+      if (auto *ptrVar = llvm::dyn_cast<Variable>(unary->operand)) {
         LocalVar *localVar = this->findVariable(ptrVar->name);
 
-        structTypeName = this->getPointedToType(localVar->typeStr);
-        if (structTypeName.empty()) {
+        structTy = localVar->sourceType->getPointee();
+        if (!structTy) {
           fprintf(stderr,
                   "Error: Cannot dereference non-pointer in member access.\n");
           std::abort();
         }
 
-        std::string mangledName = structTypeName;
-        size_t dotPos = structTypeName.find('.');
-        if (dotPos != std::string::npos) {
-          // Convert "module.Type" to "module_Type"
-          std::string moduleName = structTypeName.substr(0, dotPos);
-          std::string typeName = structTypeName.substr(dotPos + 1);
-          mangledName = moduleName + "_" + typeName;
-        } else if (!this->currentModuleName.empty()) {
-          std::string localMangled =
-              this->currentModuleName + "_" + structTypeName;
-          if (this->structTypes.find(localMangled) != this->structTypes.end()) {
-            mangledName = localMangled;
-          }
-        }
+        mangledName = this->resolveStructName(structTy);
 
         auto it = this->structTypes.find(mangledName);
         if (it == this->structTypes.end()) {
           fprintf(stderr, "Error: Unknown struct type '%s' in member access.\n",
-                  structTypeName.c_str());
+                  structTy->str().c_str());
           std::abort();
         }
         structType = it->second;
 
-        structPtr =
-            this->builder->CreateLoad(localVar->alloca->getAllocatedType(),
-                                      localVar->alloca, ptrVar->name + "_load");
+        structPtr = this->readLocal(
+            *localVar, llvm::Twine(ptrVar->name.str()) + "_load");
       } else {
         fprintf(
             stderr,
@@ -1452,7 +1836,6 @@ llvm::Value *Codegen::genMemberAccessExpr(MemberAccessExpr *expr) {
     std::abort();
   }
 
-  std::string mangledName = structType->getName().str();
   int fieldIndex = this->getFieldIndex(mangledName, expr->field);
 
   auto metaIt = this->structFieldMetadata.find(mangledName);
@@ -1462,19 +1845,20 @@ llvm::Value *Codegen::genMemberAccessExpr(MemberAccessExpr *expr) {
     std::abort();
   }
 
-  const std::string &fieldTypeStr = metaIt->second[fieldIndex].second;
-  llvm::Type *fieldType = this->getLLVMType(fieldTypeStr, this->context);
+  const Type *fieldTypeInfo = metaIt->second[fieldIndex].second;
+  llvm::Type *fieldType = this->getLLVMType(fieldTypeInfo);
 
   llvm::Value *fieldPtr = this->builder->CreateStructGEP(
-      structType, structPtr, fieldIndex, expr->field + "_ptr");
+      structType, structPtr, fieldIndex,
+      llvm::Twine(expr->field.str()) + "_ptr");
 
-  return this->builder->CreateLoad(fieldType, fieldPtr, expr->field);
+  return this->builder->CreateLoad(fieldType, fieldPtr, expr->field.str());
 }
 
 // MARK: Modules
 
 void Codegen::setModuleName(const std::string &moduleName) {
-  this->currentModuleName = moduleName;
+  this->currentModuleName = Symbol::intern(moduleName);
 }
 
 ModuleMetadata Codegen::getExportedSymbols() const {
@@ -1483,7 +1867,8 @@ ModuleMetadata Codegen::getExportedSymbols() const {
 
 void Codegen::loadImport(const std::string &modulePath,
                          const std::string &baseDir) {
-  if (this->importedModules.find(modulePath) != this->importedModules.end()) {
+  Symbol moduleKey = Symbol::intern(modulePath);
+  if (this->importedModules.find(moduleKey) != this->importedModules.end()) {
     return;
   }
 
@@ -1494,41 +1879,49 @@ void Codegen::loadImport(const std::string &modulePath,
   }
   metadataPath += modulePath + ".racm";
 
-  ModuleMetadata metadata = ModuleMetadata::loadFromFile(metadataPath);
-
-  if (metadata.moduleName.empty()) {
+  std::shared_ptr<const ModuleInterface> loaded =
+      ModuleInterface::openCached(metadataPath);
+  if (!loaded || loaded->getModuleName().empty()) {
     fprintf(stderr, "Error: Failed to load module metadata from '%s'\n",
             metadataPath.c_str());
     std::abort();
   }
 
-  this->importedModules[modulePath] = metadata;
+  const ModuleInterface &iface = *loaded;
+  this->importedModules[moduleKey] = std::move(loaded);
 
-  for (const auto &exportedStruct : metadata.structs) {
-    std::string mangledName = metadata.moduleName + "_" + exportedStruct.name;
+  Symbol moduleName = Symbol::intern(iface.getModuleName());
+  for (const auto &exportedStruct : iface.getStructs()) {
+    Symbol structName = Symbol::intern(iface.getString(exportedStruct.name));
+    Symbol mangledName = Symbol::mangle(moduleName, structName);
 
     if (this->structTypes.find(mangledName) != this->structTypes.end()) {
       continue;
     }
 
     std::vector<llvm::Type *> fieldTypes;
-    for (const auto &field : exportedStruct.fields) {
-      llvm::Type *fieldType = this->getLLVMType(field.second, this->context);
+    std::vector<std::pair<Symbol, const Type *>> fields;
+    for (const auto &field : iface.getFields(exportedStruct)) {
+      std::string_view typeName = iface.getString(field.type);
+      std::string_view fieldName = iface.getString(field.name);
+      const Type *type = this->importType(typeName, iface);
+      llvm::Type *fieldType = this->getLLVMType(type);
       if (!fieldType) {
         fprintf(stderr,
                 "Error: Invalid type '%s' for field '%s' in imported struct "
                 "'%s'.\n",
-                field.second.c_str(), field.first.c_str(),
-                exportedStruct.name.c_str());
+                std::string(typeName).c_str(), std::string(fieldName).c_str(),
+                structName.c_str());
         std::abort();
       }
       fieldTypes.push_back(fieldType);
+      fields.push_back({Symbol::intern(fieldName), type});
     }
 
     llvm::StructType *structType =
-        llvm::StructType::create(this->context, fieldTypes, mangledName);
+        llvm::StructType::create(this->context, fieldTypes, mangledName.str());
 
     this->structTypes[mangledName] = structType;
-    this->structFieldMetadata[mangledName] = exportedStruct.fields;
+    this->structFieldMetadata[mangledName] = std::move(fields);
   }
 }
@@ -1,10 +1,153 @@
 #include "Lexer.hpp"
 #include "Token.hpp"
+#include <algorithm>
 #include <cctype>
-#include <unordered_set>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+
+namespace {
+
+struct Keyword {
+  std::string_view text;
+  TokenType type;
+};
+
+constexpr Keyword keywords[] = {
+    {"fun", TokenType::KwFun},           {"let", TokenType::KwLet},
+    {"const", TokenType::KwConst},       {"struct", TokenType::KwStruct},
+    {"return", TokenType::KwReturn},     {"if", TokenType::KwIf},
+    {"else", TokenType::KwElse},         {"while", TokenType::KwWhile},
+    {"for", TokenType::KwFor},           {"import", TokenType::KwImport},
+    {"export", TokenType::KwExport},     {"malloc", TokenType::KwMalloc},
+    {"free", TokenType::KwFree},         {"true", TokenType::KwTrue},
+    {"false", TokenType::KwFalse},       {"void", TokenType::KwVoid},
+    {"restrict", TokenType::KwRestrict}, {"extern", TokenType::KwExtern},
+};
+
+constexpr size_t MinKeywordLength = [] {
+  size_t length = SIZE_MAX;
+  for (const Keyword &kw : keywords) {
+    length = std::min(length, kw.text.size());
+  }
+  return length;
+}();
+constexpr size_t MaxKeywordLength = [] {
+  size_t length = 0;
+  for (const Keyword &kw : keywords) {
+    length = std::max(length, kw.text.size());
+  }
+  return length;
+}();
+constexpr uint32_t KeywordTableSize = 64; // power of two
+
+static_assert(std::size(keywords) ==
+                  static_cast<size_t>(TokenType::KwExtern) -
+                      static_cast<size_t>(TokenType::KwFun) + 1,
+              "every keyword token needs an entry in the keyword table");
+
+// Seeded FNV-1a, masked down to a table slot.
+constexpr uint32_t keywordSlot(std::string_view text, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (char c : text) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 16777619u;
+  }
+  return hash & (KeywordTableSize - 1);
+}
+
+constexpr bool isPerfectSeed(uint32_t seed) {
+  bool used[KeywordTableSize] = {};
+  for (const Keyword &kw : keywords) {
+    uint32_t slot = keywordSlot(kw.text, seed);
+    if (used[slot]) {
+      return false;
+    }
+    used[slot] = true;
+  }
+  return true;
+}
+
+// Search for a seed that gives every keyword its own slot. This runs in the
+// compiler; adding a keyword just means a different seed gets picked.
+constexpr uint32_t findKeywordSeed() {
+  uint32_t seed = 0;
+  while (!isPerfectSeed(seed)) {
+    seed++;
+  }
+  return seed;
+}
+
+constexpr uint32_t KeywordSeed = findKeywordSeed();
+
+struct KeywordTable {
+  Keyword slots[KeywordTableSize];
+};
+
+constexpr KeywordTable buildKeywordTable() {
+  KeywordTable table{};
+  for (Keyword &slot : table.slots) {
+    slot = {"", TokenType::Identifier};
+  }
+  for (const Keyword &kw : keywords) {
+    table.slots[keywordSlot(kw.text, KeywordSeed)] = kw;
+  }
+  return table;
+}
+
+constexpr KeywordTable keywordTable = buildKeywordTable();
+
+/// Keyword token type for `text`, or TokenType::Identifier. One hash and at
+/// most one string compare.
+TokenType lookupKeyword(std::string_view text) {
+  if (text.size() < MinKeywordLength || text.size() > MaxKeywordLength) {
+    return TokenType::Identifier;
+  }
+
+  const Keyword &kw = keywordTable.slots[keywordSlot(text, KeywordSeed)];
+  return kw.text == text ? kw.type : TokenType::Identifier;
+}
+
+} // namespace
 
 Token Lexer::nextToken() {
+  if (this->lookaheadCount > 0) {
+    Token token = this->lookahead[this->lookaheadHead];
+    this->lookaheadHead = (this->lookaheadHead + 1) & (MaxLookahead - 1);
+    this->lookaheadCount--;
+    return token;
+  }
+
+  return this->lexToken();
+}
+
+static_assert((Lexer::MaxLookahead & (Lexer::MaxLookahead - 1)) == 0,
+              "lookahead ring buffer size must be a power of two");
+
+const Token &Lexer::peekToken(size_t distance) {
+  // Checked in release builds too: peeking further would overwrite buffered
+  // tokens that nextToken() has not returned yet.
+  if (distance >= MaxLookahead) {
+    std::fprintf(stderr, "Lexer: cannot peek %zu tokens ahead (at most %zu)\n",
+                 distance, MaxLookahead - 1);
+    std::abort();
+  }
+
+  while (this->lookaheadCount <= distance) {
+    size_t tail =
+        (this->lookaheadHead + this->lookaheadCount) & (MaxLookahead - 1);
+    this->lookahead[tail] = this->lexToken();
+    this->lookaheadCount++;
+  }
+
+  return this->lookahead[(this->lookaheadHead + distance) &
+                         (MaxLookahead - 1)];
+}
+
+Token Lexer::lexToken() {
   this->skipComment();
+  this->tokens++;
 
   if (pos >= this->source.size()) {
     return {TokenType::EndOfFile, "", this->line, this->column};
@@ -121,6 +264,10 @@ Token Lexer::nextToken() {
     this->pos++;
     return {TokenType::Percent, "%", this->line, this->column++};
   }
+  case '@': {
+    this->pos++;
+    return {TokenType::At, "@", this->line, this->column++};
+  }
   case '"': {
     return this->stringLiteral();
   }
@@ -205,11 +352,11 @@ Token Lexer::number() {
       this->pos++;
     }
 
-    std::string lexeme = this->source.substr(start, this->pos - start);
+    std::string_view lexeme = this->source.substr(start, this->pos - start);
 
     return {TokenType::FloatLiteral, lexeme, this->line, this->column};
   } else {
-    std::string lexeme = this->source.substr(start, this->pos - start);
+    std::string_view lexeme = this->source.substr(start, this->pos - start);
 
     return {TokenType::IntLiteral, lexeme, this->line, this->column};
   }
@@ -228,23 +375,27 @@ Token Lexer::stringLiteral() {
     }
   }
 
-  std::string lexeme = this->source.substr(start + 1, this->pos - start - 1);
+  std::string_view lexeme =
+      this->source.substr(start + 1, this->pos - start - 1);
   this->pos++;
 
   return {TokenType::StringLiteral, lexeme, this->line, this->column};
 }
 
 Token Lexer::charLiteral() {
-  size_t start = this->pos;
   this->pos++;
+  if (this->pos >= this->source.size()) {
+    return {TokenType::EndOfFile, "", this->line, this->column};
+  }
 
-  char c = this->source[this->pos++];
-  if (c == '\\' && this->pos < this->source.size()) {
-    c = this->source[this->pos++];
+  size_t valuePos = this->pos++;
+  if (this->source[valuePos] == '\\' && this->pos < this->source.size()) {
+    valuePos = this->pos++;
   }
 
   this->pos++;
-  return {TokenType::CharLiteral, std::string(1, c), this->line, this->column};
+  return {TokenType::CharLiteral, this->source.substr(valuePos, 1), this->line,
+          this->column};
 }
 
 Token Lexer::identifier() {
@@ -255,30 +406,12 @@ Token Lexer::identifier() {
     this->pos++;
   }
 
-  std::string lexeme = source.substr(start, this->pos - start);
-
-  // Check for keyword
-  static const std::unordered_set<std::string> keywords = {
-      "fun",  "let",   "const", "struct", "return", "if",
-      "else", "while", "for",   "import", "export", "malloc",
-      "free", "true",  "false", "void",   "extern"};
-
-  TokenType type =
-      keywords.count(lexeme) ? TokenType::Keyword : TokenType::Identifier;
+  std::string_view lexeme = source.substr(start, this->pos - start);
 
-  return {type, lexeme, this->line, this->column};
-}
-
-Token Lexer::peekToken() {
-  size_t oldPos = this->pos;
-  int oldLine = this->line;
-  int oldColumn = this->column;
-
-  Token token = this->nextToken();
-
-  this->pos = oldPos;
-  this->line = oldLine;
-  this->column = oldColumn;
+  TokenType type = lookupKeyword(lexeme);
+  if (type != TokenType::Identifier) {
+    return {type, lexeme, this->line, this->column};
+  }
 
-  return token;
+  return {type, lexeme, this->line, this->column, Symbol::intern(lexeme)};
 }
@@ -1,14 +1,162 @@
 #include "ModuleMetadata.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <mutex>
+#include <type_traits>
 
-void ModuleMetadata::saveToFile(const std::string &filepath) const {
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/DJB.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+namespace {
+
+/// Builds the deduplicated string table of a .racm file. Offset 0 is "".
+class StringTableBuilder {
+public:
+  StringTableBuilder() { this->data.push_back('\0'); }
+
+  uint32_t add(std::string_view str) {
+    if (str.empty()) {
+      return 0;
+    }
+    auto [it, inserted] = this->offsets.try_emplace(
+        llvm::StringRef(str.data(), str.size()), this->data.size());
+    if (inserted) {
+      this->data.append(str);
+      this->data.push_back('\0');
+    }
+    return it->getValue();
+  }
+
+  const std::string &contents() const { return this->data; }
+
+private:
+  std::string data;
+  llvm::StringMap<uint32_t> offsets;
+};
+
+racm::MemberRecord makeMember(uint32_t name, uint32_t type) {
+  racm::MemberRecord record;
+  record.name = name;
+  record.type = type;
+  return record;
+}
+
+template <typename T> void appendRecords(std::string &out, const T &records) {
+  out.append(reinterpret_cast<const char *>(records.data()),
+             records.size() * sizeof(typename T::value_type));
+}
+
+} // namespace
+
+std::string ModuleMetadata::serialize() const {
+  StringTableBuilder strings;
+  std::vector<racm::FunctionRecord> functionRecords;
+  std::vector<racm::StructRecord> structRecords;
+  std::vector<racm::MemberRecord> memberRecords;
+
+  for (const auto &func : this->functions) {
+    racm::FunctionRecord record;
+    record.name = strings.add(func.name.str());
+    record.returnType = strings.add(func.returnType);
+    record.firstParam = memberRecords.size();
+    record.paramCount = func.params.size();
+    for (const auto &param : func.params) {
+      memberRecords.push_back(makeMember(strings.add(param.first.str()),
+                                         strings.add(param.second)));
+    }
+    functionRecords.push_back(record);
+  }
+
+  for (const auto &st : this->structs) {
+    racm::StructRecord record;
+    record.name = strings.add(st.name.str());
+    record.firstField = memberRecords.size();
+    record.fieldCount = st.fields.size();
+    for (const auto &field : st.fields) {
+      memberRecords.push_back(makeMember(strings.add(field.first.str()),
+                                         strings.add(field.second)));
+    }
+    structRecords.push_back(record);
+  }
+
+  // Keep the index at most half full so probe sequences stay short.
+  size_t entryCount = functionRecords.size() + structRecords.size();
+  uint32_t bucketCount =
+      llvm::PowerOf2Ceil(std::max<size_t>(entryCount * 2, 1));
+  racm::Bucket emptyBucket;
+  emptyBucket.hash = 0;
+  emptyBucket.entry = racm::EmptyBucket;
+  std::vector<racm::Bucket> buckets(bucketCount, emptyBucket);
+  auto insert = [&](std::string_view name, uint32_t entry) {
+    uint32_t hash = llvm::djbHash(llvm::StringRef(name.data(), name.size()));
+    uint32_t slot = hash & (bucketCount - 1);
+    while (buckets[slot].entry != racm::EmptyBucket) {
+      slot = (slot + 1) & (bucketCount - 1);
+    }
+    buckets[slot].hash = hash;
+    buckets[slot].entry = entry;
+  };
+  for (size_t i = 0; i < this->functions.size(); i++) {
+    insert(this->functions[i].name.str(), i);
+  }
+  for (size_t i = 0; i < this->structs.size(); i++) {
+    insert(this->structs[i].name.str(), i | racm::StructEntry);
+  }
+
+  racm::Header header;
+  std::memcpy(header.magic, racm::Magic, sizeof(header.magic));
+  header.version = racm::Version;
+  header.moduleName = strings.add(this->moduleName);
+  header.functionCount = functionRecords.size();
+  header.structCount = structRecords.size();
+  header.memberCount = memberRecords.size();
+  header.bucketCount = bucketCount;
+  header.stringsSize = strings.contents().size();
+
+  std::string image(reinterpret_cast<const char *>(&header), sizeof(header));
+  appendRecords(image, functionRecords);
+  appendRecords(image, structRecords);
+  appendRecords(image, memberRecords);
+  appendRecords(image, buckets);
+  image += strings.contents();
+  return image;
+}
+
+bool ModuleMetadata::saveToFile(const std::string &filepath) const {
+  // Replaced in one rename: an interface mapped by ModuleInterface (in this
+  // build or in the compile server's cache) keeps seeing the old file.
+  std::string image = this->serialize();
+  llvm::Error error =
+      llvm::writeToOutput(filepath, [&](llvm::raw_ostream &out) {
+        out.write(image.data(), image.size());
+        return llvm::Error::success();
+      });
+  if (error) {
+    llvm::consumeError(std::move(error));
+    std::cerr << "Error: Cannot write metadata file: " << filepath << std::endl;
+    return false;
+  }
+  return true;
+}
+
+uint64_t ModuleMetadata::fingerprint() const {
+  return llvm::xxh3_64bits(this->serialize());
+}
+
+bool ModuleMetadata::saveTextToFile(const std::string &filepath) const {
   std::ofstream file(filepath);
   if (!file) {
     std::cerr << "Error: Cannot write metadata file: " << filepath << std::endl;
-    return;
+    return false;
   }
 
   // Boring text format:
@@ -37,82 +185,176 @@ void ModuleMetadata::saveToFile(const std::string &filepath) const {
   }
 
   file.close();
+  return static_cast<bool>(file);
 }
 
-ModuleMetadata ModuleMetadata::loadFromFile(const std::string &filepath) {
-  ModuleMetadata metadata;
-  std::ifstream file(filepath);
+std::shared_ptr<const ModuleInterface>
+ModuleInterface::openCached(const std::string &filepath) {
+  std::string error;
+  std::shared_ptr<const ModuleInterface> iface = loadCached(filepath, error);
+  if (!iface) {
+    std::cerr << "Error: " << error << "\n";
+  }
+  return iface;
+}
 
-  if (!file) {
-    std::cerr << "Error: Cannot read metadata file: " << filepath << "\n";
-    return metadata;
-  }
-
-  std::string line;
-  while (std::getline(file, line)) {
-    std::istringstream iss(line);
-    std::string keyword;
-    iss >> keyword;
-
-    if (keyword == "MODULE") {
-      iss >> metadata.moduleName;
-    } else if (keyword == "FUNCTION") {
-      ExportedFunction func;
-      int paramCount;
-      iss >> func.name >> func.returnType >> paramCount;
-
-      // Read parameters
-      for (int i = 0; i < paramCount; ++i) {
-        std::getline(file, line);
-        std::istringstream paramIss(line);
-        std::string paramKeyword, paramName, paramType;
-        paramIss >> paramKeyword >> paramName >> paramType;
-        if (paramKeyword == "PARAM") {
-          func.params.push_back({paramName, paramType});
-        }
-      }
+bool ModuleInterface::preload(const std::string &filepath) {
+  std::string error;
+  return loadCached(filepath, error) != nullptr;
+}
 
-      metadata.functions.push_back(func);
-    } else if (keyword == "STRUCT") {
-      ExportedStruct st;
-      int fieldCount;
-      iss >> st.name >> fieldCount;
-
-      // Read fields
-      for (int i = 0; i < fieldCount; ++i) {
-        std::getline(file, line);
-        std::istringstream fieldIss(line);
-        std::string fieldKeyword, fieldName, fieldType;
-        fieldIss >> fieldKeyword >> fieldName >> fieldType;
-        if (fieldKeyword == "FIELD") {
-          st.fields.push_back({fieldName, fieldType});
-        }
-      }
+std::shared_ptr<const ModuleInterface>
+ModuleInterface::loadCached(const std::string &filepath, std::string &error) {
+  struct Entry {
+    llvm::sys::fs::UniqueID id;
+    llvm::sys::TimePoint<> modified;
+    uint64_t size;
+    std::shared_ptr<const ModuleInterface> iface;
+  };
+  static std::mutex mutex;
+  static llvm::StringMap<Entry> cache;
 
-      metadata.structs.push_back(st);
-    }
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(filepath, status)) {
+    error = "Cannot read metadata file: " + filepath;
+    return nullptr;
   }
 
-  file.close();
-  return metadata;
+  // Keyed on the absolute path, so that a worker asking for ./m.racm finds
+  // what the server loaded from the client's directory.
+  llvm::SmallString<256> key(filepath);
+  llvm::sys::fs::make_absolute(key);
+  llvm::sys::path::remove_dots(key, /*remove_dot_dot=*/true);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  Entry &entry = cache[key];
+  if (!entry.iface || entry.id != status.getUniqueID() ||
+      entry.modified != status.getLastModificationTime() ||
+      entry.size != status.getSize()) {
+    entry = {status.getUniqueID(), status.getLastModificationTime(),
+             status.getSize(), load(filepath, error)};
+  }
+  return entry.iface;
 }
 
-const ExportedFunction *
-ModuleMetadata::findFunction(const std::string &name) const {
-  for (const auto &func : functions) {
-    if (func.name == name) {
-      return &func;
+std::unique_ptr<ModuleInterface>
+ModuleInterface::load(const std::string &filepath, std::string &error) {
+  // No null terminator needed, so large files are mapped rather than read.
+  auto buffer = llvm::MemoryBuffer::getFile(filepath, /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false);
+  if (!buffer) {
+    error = "Cannot read metadata file: " + filepath;
+    return nullptr;
+  }
+
+  auto iface = std::unique_ptr<ModuleInterface>(new ModuleInterface());
+  iface->buffer = std::move(*buffer);
+  const char *data = iface->buffer->getBufferStart();
+  uint64_t size = iface->buffer->getBufferSize();
+
+  if (size < sizeof(racm::Header) ||
+      std::memcmp(data, racm::Magic, sizeof(racm::Magic)) != 0) {
+    error = "'" + filepath +
+            "' is not a binary module interface; rebuild it with -f";
+    return nullptr;
+  }
+
+  const auto *header = reinterpret_cast<const racm::Header *>(data);
+  if (header->version != racm::Version) {
+    error = "'" + filepath + "' has interface version " +
+            std::to_string(header->version) + ", expected " +
+            std::to_string(racm::Version) + "; rebuild it with -f";
+    return nullptr;
+  }
+
+  uint64_t offset = sizeof(racm::Header);
+  auto take = [&](auto &out, uint32_t count) {
+    using Record = typename std::remove_reference_t<decltype(out)>::value_type;
+    uint64_t bytes = uint64_t(count) * sizeof(Record);
+    if (offset + bytes > size) {
+      return false;
     }
+    out = {reinterpret_cast<const Record *>(data + offset), count};
+    offset += bytes;
+    return true;
+  };
+
+  uint32_t bucketCount = header->bucketCount;
+  if (!take(iface->functions, header->functionCount) ||
+      !take(iface->structs, header->structCount) ||
+      !take(iface->members, header->memberCount) ||
+      !take(iface->buckets, bucketCount) ||
+      !llvm::isPowerOf2_32(bucketCount) || header->stringsSize == 0 ||
+      offset + header->stringsSize > size ||
+      data[offset + header->stringsSize - 1] != '\0') {
+    error = "Metadata file '" + filepath + "' is corrupt";
+    return nullptr;
   }
-  return nullptr;
+
+  iface->header = header;
+  iface->strings = data + offset;
+  iface->stringsSize = header->stringsSize;
+  return iface;
 }
 
-const ExportedStruct *
-ModuleMetadata::findStruct(const std::string &name) const {
-  for (const auto &st : structs) {
-    if (st.name == name) {
-      return &st;
+llvm::ArrayRef<racm::MemberRecord>
+ModuleInterface::getMembers(uint32_t first, uint32_t count) const {
+  if (uint64_t(first) + count > this->members.size()) {
+    return {};
+  }
+  return this->members.slice(first, count);
+}
+
+std::string_view ModuleInterface::getString(uint32_t offset) const {
+  if (offset >= this->stringsSize) {
+    return {};
+  }
+  // The table ends in '\0' (checked in load), so this cannot run off the end.
+  return std::string_view(this->strings + offset);
+}
+
+uint32_t ModuleInterface::lookup(std::string_view name, uint32_t kind) const {
+  uint32_t hash = llvm::djbHash(llvm::StringRef(name.data(), name.size()));
+  uint32_t mask = this->buckets.size() - 1;
+  for (uint32_t slot = hash & mask, probes = 0; probes < this->buckets.size();
+       slot = (slot + 1) & mask, probes++) {
+    const racm::Bucket &bucket = this->buckets[slot];
+    uint32_t entry = bucket.entry;
+    if (entry == racm::EmptyBucket) {
+      return racm::EmptyBucket;
+    }
+    if (bucket.hash != hash || (entry & racm::StructEntry) != kind) {
+      continue;
+    }
+
+    uint32_t index = entry & ~racm::StructEntry;
+    uint32_t nameOffset;
+    if (kind == racm::StructEntry) {
+      if (index >= this->structs.size()) {
+        continue;
+      }
+      nameOffset = this->structs[index].name;
+    } else {
+      if (index >= this->functions.size()) {
+        continue;
+      }
+      nameOffset = this->functions[index].name;
+    }
+    if (this->getString(nameOffset) == name) {
+      return index;
     }
   }
-  return nullptr;
+  return racm::EmptyBucket;
+}
+
+const racm::FunctionRecord *
+ModuleInterface::findFunction(std::string_view name) const {
+  uint32_t index = this->lookup(name, 0);
+  return index == racm::EmptyBucket ? nullptr : &this->functions[index];
+}
+
+const racm::StructRecord *
+ModuleInterface::findStruct(std::string_view name) const {
+  uint32_t index = this->lookup(name, racm::StructEntry);
+  return index == racm::EmptyBucket ? nullptr : &this->structs[index];
 }
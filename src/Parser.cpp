@@ -1,96 +1,103 @@
 #include "Parser.hpp"
 #include "AST.hpp"
 #include "Token.hpp"
+#include <charconv>
 #include <iostream>
 #include <string>
 
 void Parser::advance() { this->current = this->lexer.nextToken(); }
-Token Parser::peek() { return this->lexer.peekToken(); }
+const Token &Parser::peek(size_t distance) {
+  return this->lexer.peekToken(distance);
+}
 
 Statement *Parser::parseStatement(bool insideFunction) {
-  if (!insideFunction && this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "import") {
-    return this->parseImportDecl();
-  }
+  switch (this->current.type) {
+  case TokenType::KwImport:
+    if (!insideFunction) {
+      return this->parseImportDecl();
+    }
+    break;
 
-  if (!insideFunction && this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "extern") {
-    this->advance(); // consume 'extern'
+  case TokenType::KwExtern:
+    if (!insideFunction) {
+      this->advance(); // consume 'extern'
 
-    if (this->current.type == TokenType::Keyword &&
-        this->current.lexeme == "fun") {
-      return this->parseFunctionDecl(true);
-    }
+      if (this->current.type == TokenType::KwFun) {
+        return this->parseFunctionDecl(true);
+      }
 
-    return nullptr;
-  }
+      return nullptr;
+    }
+    break;
 
-  if (!insideFunction && this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "export") {
-    this->advance(); // consume 'export'
+  case TokenType::KwExport:
+    if (!insideFunction) {
+      this->advance(); // consume 'export'
 
-    if (this->current.type == TokenType::Keyword &&
-        this->current.lexeme == "fun") {
-      Statement *funcDecl = this->parseFunctionDecl(false);
-      if (FunctionDecl *fd = dynamic_cast<FunctionDecl *>(funcDecl)) {
-        fd->isExported = true;
+      if (this->current.type == TokenType::KwFun) {
+        Statement *funcDecl = this->parseFunctionDecl(false);
+        if (auto *fd = llvm::dyn_cast_or_null<FunctionDecl>(funcDecl)) {
+          fd->isExported = true;
+        }
+        return funcDecl;
       }
-      return funcDecl;
-    }
 
-    if (this->current.type == TokenType::Keyword &&
-        this->current.lexeme == "struct") {
-      Statement *structDecl = this->parseStructDecl();
-      if (StructDecl *sd = dynamic_cast<StructDecl *>(structDecl)) {
-        sd->isExported = true;
+      if (this->current.type == TokenType::KwStruct) {
+        Statement *structDecl = this->parseStructDecl();
+        if (auto *sd = llvm::dyn_cast_or_null<StructDecl>(structDecl)) {
+          sd->isExported = true;
+        }
+        return structDecl;
       }
-      return structDecl;
-    }
 
-    return nullptr; // error
-  }
+      return nullptr; // error
+    }
+    break;
 
-  if (this->current.type == TokenType::Keyword &&
-      (this->current.lexeme == "let" || this->current.lexeme == "const")) {
-    bool isConst = (this->current.lexeme == "const");
+  case TokenType::KwLet:
+  case TokenType::KwConst: {
+    bool isConst = (this->current.type == TokenType::KwConst);
 
     this->advance(); // consume 'let' or 'const'
 
     return this->parseVarDecl(isConst);
   }
 
-  if (!insideFunction && this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "struct") {
-    return this->parseStructDecl();
-  }
+  case TokenType::KwStruct:
+    if (!insideFunction) {
+      return this->parseStructDecl();
+    }
+    break;
 
-  if (!insideFunction && this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "fun") {
-    return this->parseFunctionDecl(false);
-  }
+  case TokenType::KwFun:
+    if (!insideFunction) {
+      return this->parseFunctionDecl(false);
+    }
+    break;
 
-  if (this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "if") {
+  case TokenType::At:
+    if (!insideFunction) {
+      return this->parseAttributedFunctionDecl();
+    }
+    break;
+
+  case TokenType::KwIf:
     return this->parseIfStatement();
-  }
 
-  if (this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "while") {
+  case TokenType::KwWhile:
     return this->parseWhileStatement();
-  }
 
-  if (this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "for") {
+  case TokenType::KwFor:
     return this->parseForStatement();
-  }
 
-  if (this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "return") {
+  case TokenType::KwReturn:
     return this->parseReturnStatement();
-  }
 
-  if (this->current.type == TokenType::LeftBrace) {
+  case TokenType::LeftBrace:
     return this->parseBlockStatement();
+
+  default:
+    break;
   }
 
   return this->parseExpressionStatement();
@@ -101,34 +108,16 @@ Statement *Parser::parseVarDecl(bool isConst) {
     return nullptr; // error
   }
 
-  std::string name = this->current.lexeme;
+  Symbol name = this->current.symbol;
   this->advance(); // consume identifier
 
-  std::string type = "i32"; // default type
+  const Type *type = this->types.getI32(); // default type
   if (this->current.type == TokenType::Colon) {
     this->advance(); // consume ':'
-    if (this->current.type != TokenType::Identifier) {
+    type = this->parseType();
+    if (!type) {
       return nullptr; // error
     }
-
-    type = this->current.lexeme;
-    this->advance(); // consume first identifier
-
-    // Handle optional module prefix (ModuleName.TypeName)
-    if (this->current.type == TokenType::Dot) {
-      this->advance(); // consume '.'
-      if (this->current.type != TokenType::Identifier) {
-        return nullptr; // error
-      }
-      type += "." + this->current.lexeme;
-      this->advance(); // consume type identifier
-    }
-
-    // Handle pointer stars if any
-    while (this->current.type == TokenType::Star) {
-      type += "*";
-      this->advance();
-    }
   }
 
   Expr *initializer = nullptr;
@@ -142,13 +131,63 @@ Statement *Parser::parseVarDecl(bool isConst) {
   }
 
   if (this->current.type != TokenType::Semicolon) {
-    delete initializer;
     return nullptr; // error
   }
 
   this->advance(); // consume ';'
 
-  return new VarDecl{name, type, initializer, isConst};
+  return this->arena.make<VarDecl>(name, type, initializer, isConst);
+}
+
+// @target_clones("avx2", "default") [export] fun ...
+Statement *Parser::parseAttributedFunctionDecl() {
+  this->advance(); // consume '@'
+  if (this->current.type != TokenType::Identifier ||
+      this->current.lexeme != "target_clones") {
+    std::cerr << "Unknown attribute '@" << this->current.lexeme << "'\n";
+    return nullptr;
+  }
+  this->advance(); // consume 'target_clones'
+
+  if (this->current.type != TokenType::LeftParen) {
+    return nullptr;
+  } // missing '('
+  this->advance(); // consume '('
+
+  auto targets = this->arena.makeVector<std::string_view>();
+  while (this->current.type == TokenType::StringLiteral) {
+    targets.push_back(this->current.lexeme);
+    this->advance(); // consume target
+    if (this->current.type != TokenType::Comma) {
+      break;
+    }
+    this->advance(); // consume ','
+  }
+
+  if (this->current.type != TokenType::RightParen || targets.empty()) {
+    std::cerr << "Expected a list of targets in @target_clones(...)\n";
+    return nullptr;
+  }
+  this->advance(); // consume ')'
+
+  bool exported = false;
+  if (this->current.type == TokenType::KwExport) {
+    exported = true;
+    this->advance(); // consume 'export'
+  }
+  if (this->current.type != TokenType::KwFun) {
+    std::cerr << "@target_clones must be followed by a function\n";
+    return nullptr;
+  }
+
+  auto *funcDecl =
+      llvm::dyn_cast_or_null<FunctionDecl>(this->parseFunctionDecl(false));
+  if (!funcDecl) {
+    return nullptr;
+  }
+  funcDecl->isExported = exported;
+  funcDecl->targetClones = std::move(targets);
+  return funcDecl;
 }
 
 Statement *Parser::parseFunctionDecl(bool isExtern) {
@@ -158,7 +197,7 @@ Statement *Parser::parseFunctionDecl(bool isExtern) {
     return nullptr;
   } // missing function name
 
-  std::string name = this->current.lexeme;
+  Symbol name = this->current.symbol;
   this->advance(); // consume function name
 
   if (this->current.type != TokenType::LeftParen) {
@@ -166,7 +205,8 @@ Statement *Parser::parseFunctionDecl(bool isExtern) {
   } // missing '('
   this->advance(); // consume '('
 
-  std::vector<std::pair<std::string, std::string>> params;
+  auto params = this->arena.makeVector<std::pair<Symbol, const Type *>>();
+  auto restrictParams = this->arena.makeVector<unsigned>();
 
   // Parse zero or more parameters
   while (this->current.type != TokenType::RightParen &&
@@ -174,7 +214,7 @@ Statement *Parser::parseFunctionDecl(bool isExtern) {
     if (this->current.type != TokenType::Identifier) {
       return nullptr;
     } // expected parameter name
-    std::string paramName = this->current.lexeme;
+    Symbol paramName = this->current.symbol;
     this->advance(); // consume parameter name
 
     if (this->current.type != TokenType::Colon) {
@@ -182,16 +222,17 @@ Statement *Parser::parseFunctionDecl(bool isExtern) {
     } // expected ':'
     this->advance(); // consume ':'
 
-    if (this->current.type != TokenType::Identifier) {
+    const Type *paramType = this->parseType();
+    if (!paramType) {
       return nullptr;
     } // expected type
-    std::string paramType = this->current.lexeme;
-    this->advance(); // consume type
 
-    // Handle pointer stars
-    while (this->current.type == TokenType::Star) {
-      paramType += "*";
-      this->advance();
+    if (this->current.type == TokenType::KwRestrict) {
+      if (!paramType->isPointer()) {
+        return nullptr;
+      } // only pointers can be restrict
+      this->advance(); // consume 'restrict'
+      restrictParams.push_back(params.size());
     }
 
     params.push_back({paramName, paramType});
@@ -210,21 +251,13 @@ Statement *Parser::parseFunctionDecl(bool isExtern) {
   this->advance(); // consume ')'
 
   // Parse optional return type
-  std::string returnType = "void";
+  const Type *returnType = this->types.getVoid();
   if (this->current.type == TokenType::Colon) {
     this->advance(); // consume ':'
-    if (this->current.type != TokenType::Identifier &&
-        this->current.type != TokenType::Keyword) {
+    returnType = this->parseType();
+    if (!returnType) {
       return nullptr;
     }
-    returnType = this->current.lexeme;
-    this->advance(); // consume base type
-
-    // Handle pointer stars for return type
-    while (this->current.type == TokenType::Star) {
-      returnType += "*";
-      this->advance();
-    }
   }
   if (isExtern) {
     if (this->current.type != TokenType::Semicolon) {
@@ -232,14 +265,18 @@ Statement *Parser::parseFunctionDecl(bool isExtern) {
     }
     this->advance(); // consume ';'
 
-    return new FunctionDecl(name, params, {}, returnType, false, true);
+    auto *decl = this->arena.make<FunctionDecl>(
+        name, std::move(params), this->arena.makeVector<Statement *>(),
+        returnType, false, true);
+    decl->restrictParams = std::move(restrictParams);
+    return decl;
   }
   if (this->current.type != TokenType::LeftBrace) {
     return nullptr;
   } // missing '{'
   this->advance(); // consume '{'
 
-  std::vector<Statement *> body;
+  auto body = this->arena.makeVector<Statement *>();
   while (this->current.type != TokenType::RightBrace &&
          this->current.type != TokenType::EndOfFile) {
     Statement *stmt = this->parseStatement(true);
@@ -255,7 +292,10 @@ Statement *Parser::parseFunctionDecl(bool isExtern) {
   } // missing '}'
   this->advance(); // consume '}'
 
-  return new FunctionDecl(name, params, body, returnType, false, false);
+  auto *decl = this->arena.make<FunctionDecl>(
+      name, std::move(params), std::move(body), returnType, false, false);
+  decl->restrictParams = std::move(restrictParams);
+  return decl;
 }
 Expr *Parser::parseExpression(int precedence) {
   Expr *left = this->parseUnary();
@@ -268,14 +308,13 @@ Expr *Parser::parseExpression(int precedence) {
       this->advance(); // consume '.'
 
       if (this->current.type != TokenType::Identifier) {
-        delete left;
         return nullptr; // error
       }
 
-      std::string fieldName = this->current.lexeme;
+      Symbol fieldName = this->current.symbol;
       this->advance(); // consume field name
 
-      left = new MemberAccessExpr(left, fieldName);
+      left = this->arena.make<MemberAccessExpr>(left, fieldName);
       continue;
     }
 
@@ -297,104 +336,96 @@ Expr *Parser::parseExpression(int precedence) {
     Expr *right = parseExpression(opPrecedence + 1);
     if (!right)
       break;
-    left = new BinaryExpr(left, right, op);
+    left = this->arena.make<BinaryExpr>(left, right, op);
   }
   return left;
 }
 
 Expr *Parser::parsePrimary() {
   if (this->current.type == TokenType::IntLiteral) {
-    int value = std::stoll(this->current.lexeme);
+    long long parsed = 0;
+    std::from_chars(this->current.lexeme.data(),
+                    this->current.lexeme.data() + this->current.lexeme.size(),
+                    parsed);
+    int value = parsed;
     this->advance(); // consume integer literal
-    return new IntLiteral(value);
+    return this->arena.make<IntLiteral>(value);
   }
   if (this->current.type == TokenType::FloatLiteral) {
-    float value = std::stof(this->current.lexeme);
+    float value = 0.0f;
+    std::from_chars(this->current.lexeme.data(),
+                    this->current.lexeme.data() + this->current.lexeme.size(),
+                    value);
     this->advance(); // consume float literal
-    return new FloatLiteral(value);
+    return this->arena.make<FloatLiteral>(value);
   }
-  if (this->current.type == TokenType::Keyword &&
-      (this->current.lexeme == "true" || this->current.lexeme == "false")) {
-    bool value = (this->current.lexeme == "true");
+  if (this->current.type == TokenType::KwTrue ||
+      this->current.type == TokenType::KwFalse) {
+    bool value = (this->current.type == TokenType::KwTrue);
     this->advance(); // consume boolean literal
-    return new BoolLiteral(value);
+    return this->arena.make<BoolLiteral>(value);
   }
   if (this->current.type == TokenType::CharLiteral) {
     char value = this->current.lexeme[0];
     this->advance(); // consume char literal
-    return new CharLiteral(value);
+    return this->arena.make<CharLiteral>(value);
   }
   if (this->current.type == TokenType::StringLiteral) {
-    std::string value = this->current.lexeme;
+    std::string_view value = this->current.lexeme;
     this->advance(); // consume string literal
-    return new StrLiteral(value);
+    return this->arena.make<StrLiteral>(value);
   }
   if (this->current.type == TokenType::Identifier) {
-    std::string name = this->current.lexeme;
-
-    if (!(this->current.type == TokenType::Keyword &&
-          this->current.lexeme == "fun")) {
-      this->advance();
-    }
+    Symbol name = this->current.symbol;
 
-    std::string moduleName = "";
-    if (this->current.type == TokenType::Dot) {
-      // Look ahead to see if this is module qualification or member access
-      // Module qualification: module.Function(...) or module.Struct{...}
-      // Member access: object.field (handled by parseExpression)
+    this->advance();
 
+    // Module qualification: module.Function(...) or module.Struct{...}
+    // Member access: object.field
+    Symbol moduleName;
+    if (this->current.type == TokenType::Dot &&
+        this->peek().type == TokenType::Identifier &&
+        (this->peek(1).type == TokenType::LeftParen ||
+         this->peek(1).type == TokenType::LeftBrace)) {
+      this->advance(); // consume '.'
+      moduleName = name;
+      name = this->current.symbol;
+      this->advance(); // consume function or struct name
+    } else if (this->current.type == TokenType::Dot) {
       this->advance(); // consume '.'
 
       if (this->current.type != TokenType::Identifier) {
         return nullptr;
       }
 
-      std::string afterDot = this->current.lexeme;
-      this->advance(); // consume identifier after dot
-
-      // Check what follows to determine the context
-      if (this->current.type == TokenType::LeftParen ||
-          this->current.type == TokenType::LeftBrace) {
-        // This is module.Function() or module.Struct{}
-        moduleName = name;
-        name = afterDot;
-      } else {
-        // This is object.field - create MemberAccessExpr
-        Variable *obj = new Variable(name);
-        return new MemberAccessExpr(obj, afterDot);
-      }
+      Symbol fieldName = this->current.symbol;
+      this->advance(); // consume field name
+
+      Variable *obj = this->arena.make<Variable>(name);
+      return this->arena.make<MemberAccessExpr>(obj, fieldName);
     }
 
     if (this->current.type == TokenType::LeftBrace) {
       this->advance(); // consume '{'
 
-      std::vector<std::pair<std::string, Expr *>> fieldInits;
+      auto fieldInits = this->arena.makeVector<std::pair<Symbol, Expr *>>();
 
       while (this->current.type != TokenType::RightBrace &&
              this->current.type != TokenType::EndOfFile) {
         if (this->current.type != TokenType::Identifier) {
-          for (auto &pair : fieldInits) {
-            delete pair.second;
-          }
           return nullptr;
         }
 
-        std::string fieldName = this->current.lexeme;
+        Symbol fieldName = this->current.symbol;
         this->advance(); // consume field name
 
         if (this->current.type != TokenType::Colon) {
-          for (auto &pair : fieldInits) {
-            delete pair.second;
-          }
           return nullptr;
         }
         this->advance(); // consume ':'
 
         Expr *fieldValue = this->parseExpression();
         if (!fieldValue) {
-          for (auto &pair : fieldInits) {
-            delete pair.second;
-          }
           return nullptr;
         }
 
@@ -404,34 +435,26 @@ Expr *Parser::parsePrimary() {
           this->advance(); // consume ','
 
         } else if (this->current.type != TokenType::RightBrace) {
-          for (auto &pair : fieldInits) {
-            delete pair.second;
-          }
           return nullptr;
         }
       }
 
       if (this->current.type != TokenType::RightBrace) {
-        for (auto &pair : fieldInits) {
-          delete pair.second;
-        }
         return nullptr;
       }
       this->advance(); // consume '}'
 
-      return new StructLiteral(name, fieldInits, moduleName);
+      return this->arena.make<StructLiteral>(name, std::move(fieldInits),
+                                             moduleName);
     }
 
     if (this->current.type == TokenType::LeftParen) {
       this->advance();
-      std::vector<Expr *> args;
+      auto args = this->arena.makeVector<Expr *>();
       while (this->current.type != TokenType::RightParen &&
              this->current.type != TokenType::EndOfFile) {
         Expr *arg = this->parseExpression();
         if (!arg) {
-          for (auto a : args) {
-            delete a;
-          }
           return nullptr;
         }
         args.push_back(arg);
@@ -440,41 +463,37 @@ Expr *Parser::parsePrimary() {
         }
       }
       if (this->current.type != TokenType::RightParen) {
-        for (auto a : args) {
-          delete a;
-        }
         return nullptr;
       }
       this->advance();
-      return new CallExpr(name, args, "", moduleName);
+      return this->arena.make<CallExpr>(name, std::move(args), nullptr,
+                                        moduleName);
     }
 
-    return new Variable(name);
+    return this->arena.make<Variable>(name);
   }
 
   if (this->current.type == TokenType::LeftParen) {
     this->advance(); // consume '('
     Expr *expr = this->parseExpression();
     if (this->current.type != TokenType::RightParen) {
-      delete expr;
       return nullptr; // error
     }
     this->advance(); // consume ')'
     return expr;
   }
 
-  if (current.type == TokenType::Keyword &&
-      (current.lexeme == "malloc" || current.lexeme == "free")) {
-    std::string name = current.lexeme;
+  if (current.type == TokenType::KwMalloc ||
+      current.type == TokenType::KwFree) {
+    Symbol name = Symbol::intern(current.lexeme);
     this->advance(); // consume keyword
 
-    std::string typeArg;
+    const Type *typeArg = nullptr;
     if (current.type == TokenType::LessThan) {
       this->advance();
-      if (current.type != TokenType::Identifier)
+      typeArg = this->parseType();
+      if (!typeArg)
         return nullptr;
-      typeArg = current.lexeme;
-      this->advance();
       if (current.type != TokenType::GreaterThan)
         return nullptr;
       this->advance();
@@ -483,7 +502,7 @@ Expr *Parser::parsePrimary() {
     if (current.type != TokenType::LeftParen)
       return nullptr;
     this->advance();
-    std::vector<Expr *> args;
+    auto args = this->arena.makeVector<Expr *>();
     while (current.type != TokenType::RightParen &&
            current.type != TokenType::EndOfFile) {
       Expr *arg = parseExpression();
@@ -496,12 +515,44 @@ Expr *Parser::parsePrimary() {
     if (current.type != TokenType::RightParen)
       return nullptr;
     advance();
-    return new CallExpr(name, args, typeArg, "");
+    return this->arena.make<CallExpr>(name, std::move(args), typeArg);
   }
 
   return nullptr;
 }
 
+const Type *Parser::parseType() {
+  const Type *type = nullptr;
+  if (this->current.type == TokenType::KwVoid) {
+    type = this->types.getVoid();
+    this->advance(); // consume 'void'
+  } else if (this->current.type == TokenType::Identifier) {
+    Symbol name = this->current.symbol;
+    this->advance(); // consume first identifier
+
+    // Handle optional module prefix (ModuleName.TypeName)
+    if (this->current.type == TokenType::Dot) {
+      this->advance(); // consume '.'
+      if (this->current.type != TokenType::Identifier) {
+        return nullptr; // error
+      }
+      type = this->types.getQualified(name, this->current.symbol);
+      this->advance(); // consume type identifier
+    } else {
+      type = this->types.getNamed(name);
+    }
+  } else {
+    return nullptr; // error
+  }
+
+  // Handle pointer stars if any
+  while (this->current.type == TokenType::Star) {
+    type = this->types.getPointerTo(type);
+    this->advance();
+  }
+  return type;
+}
+
 int Parser::getPrecedence(TokenType type) {
   switch (type) {
   case TokenType::Star:
@@ -538,12 +589,11 @@ Statement *Parser::parseExpressionStatement() {
   }
 
   if (this->current.type != TokenType::Semicolon) {
-    delete expr;
     this->advance(); // skip to recover
     return nullptr;  // error
   }
   this->advance(); // consume ';'
-  return new ExprStmt(expr);
+  return this->arena.make<ExprStmt>(expr);
 }
 
 Expr *Parser::parseInitializer() {
@@ -572,18 +622,16 @@ Statement *Parser::parseIfStatement() {
   }
 
   if (this->current.type != TokenType::RightParen) {
-    delete condition;
     return nullptr; // error
   }
   this->advance(); // consume ')'
 
   if (this->current.type != TokenType::LeftBrace) {
-    delete condition;
     return nullptr; // error
   }
   this->advance(); // consume '{'
 
-  std::vector<Statement *> thenBranch;
+  auto thenBranch = this->arena.makeVector<Statement *>();
   while (this->current.type != TokenType::RightBrace &&
          this->current.type != TokenType::EndOfFile) {
     Statement *stmt = this->parseStatement(true);
@@ -595,23 +643,14 @@ Statement *Parser::parseIfStatement() {
   }
 
   if (this->current.type != TokenType::RightBrace) {
-    delete condition;
-    for (auto s : thenBranch) {
-      delete s;
-    }
     return nullptr; // error
   }
   this->advance(); // consume '}'
 
-  std::vector<Statement *> elseBranch;
-  if (this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "else") {
+  auto elseBranch = this->arena.makeVector<Statement *>();
+  if (this->current.type == TokenType::KwElse) {
     this->advance(); // consume 'else'
     if (this->current.type != TokenType::LeftBrace) {
-      delete condition;
-      for (auto s : thenBranch) {
-        delete s;
-      }
       return nullptr; // error
     }
     this->advance(); // consume '{'
@@ -626,19 +665,13 @@ Statement *Parser::parseIfStatement() {
       elseBranch.push_back(stmt);
     }
     if (this->current.type != TokenType::RightBrace) {
-      delete condition;
-      for (auto s : thenBranch) {
-        delete s;
-      }
-      for (auto s : elseBranch) {
-        delete s;
-      }
       return nullptr; // error
     }
     this->advance(); // consume '}'
   }
 
-  return new IfStmt(condition, thenBranch, elseBranch);
+  return this->arena.make<IfStmt>(condition, std::move(thenBranch),
+                                  std::move(elseBranch));
 }
 
 Statement *Parser::parseWhileStatement() {
@@ -654,18 +687,16 @@ Statement *Parser::parseWhileStatement() {
   }
 
   if (this->current.type != TokenType::RightParen) {
-    delete condition;
     return nullptr; // error
   }
   this->advance(); // consume ')'
 
   if (this->current.type != TokenType::LeftBrace) {
-    delete condition;
     return nullptr; // error
   }
   this->advance(); // consume '{'
 
-  std::vector<Statement *> body;
+  auto body = this->arena.makeVector<Statement *>();
   while (this->current.type != TokenType::RightBrace &&
          this->current.type != TokenType::EndOfFile) {
     Statement *stmt = this->parseStatement(true);
@@ -677,16 +708,12 @@ Statement *Parser::parseWhileStatement() {
   }
 
   if (this->current.type != TokenType::RightBrace) {
-    delete condition;
-    for (auto s : body) {
-      delete s;
-    }
     return nullptr; // error
   }
 
   this->advance(); // consume '}'
 
-  return new WhileStmt{condition, body};
+  return this->arena.make<WhileStmt>(condition, std::move(body));
 }
 
 Statement *Parser::parseForStatement() {
@@ -698,12 +725,10 @@ Statement *Parser::parseForStatement() {
   this->advance(); // consume '('
 
   Statement *initializer = nullptr;
-  if (this->current.type == TokenType::Keyword &&
-      this->current.lexeme == "let") {
+  if (this->current.type == TokenType::KwLet) {
     this->advance();
     initializer = this->parseVarDecl(false);
-  } else if (this->current.type == TokenType::Keyword &&
-             this->current.lexeme == "const") {
+  } else if (this->current.type == TokenType::KwConst) {
     this->advance();
     initializer = this->parseVarDecl(true);
   } else if (this->current.type != TokenType::Semicolon) {
@@ -716,8 +741,6 @@ Statement *Parser::parseForStatement() {
   }
 
   if (this->current.type != TokenType::Semicolon) {
-    delete initializer;
-    delete condition;
     return nullptr; // error
   }
   this->advance(); // consume ';'
@@ -728,22 +751,16 @@ Statement *Parser::parseForStatement() {
   }
 
   if (this->current.type != TokenType::RightParen) {
-    delete initializer;
-    delete condition;
-    delete increment;
     return nullptr; // error
   }
   this->advance(); // consume ')'
 
   if (this->current.type != TokenType::LeftBrace) {
-    delete initializer;
-    delete condition;
-    delete increment;
     return nullptr; // error
   }
   this->advance(); // consume '{'
 
-  std::vector<Statement *> body;
+  auto body = this->arena.makeVector<Statement *>();
   while (this->current.type != TokenType::RightBrace &&
          this->current.type != TokenType::EndOfFile) {
     Statement *stmt = this->parseStatement(true);
@@ -755,17 +772,12 @@ Statement *Parser::parseForStatement() {
   }
 
   if (this->current.type != TokenType::RightBrace) {
-    delete initializer;
-    delete condition;
-    delete increment;
-    for (auto s : body) {
-      delete s;
-    }
     return nullptr; // error
   }
   this->advance(); // consume '}'
 
-  return new ForStmt(initializer, condition, increment, body);
+  return this->arena.make<ForStmt>(initializer, condition, increment,
+                                   std::move(body));
 }
 
 Statement *Parser::parseReturnStatement() {
@@ -782,18 +794,17 @@ Statement *Parser::parseReturnStatement() {
   }
 
   if (this->current.type != TokenType::Semicolon) {
-    delete value;
     this->advance(); // skip erroneous token
     return nullptr;  // error
   }
   this->advance(); // consume ';'
 
-  return new ReturnStmt(value);
+  return this->arena.make<ReturnStmt>(value);
 }
 
 Statement *Parser::parseBlockStatement() {
   this->advance(); // consume '{'
-  std::vector<Statement *> statements;
+  auto statements = this->arena.makeVector<Statement *>();
 
   while (this->current.type != TokenType::RightBrace &&
          this->current.type != TokenType::EndOfFile) {
@@ -806,14 +817,11 @@ Statement *Parser::parseBlockStatement() {
   }
 
   if (this->current.type != TokenType::RightBrace) {
-    for (auto s : statements) {
-      delete s;
-    }
     return nullptr; // error
   }
   this->advance(); // consume '}'
 
-  return new BlockStmt(statements);
+  return this->arena.make<BlockStmt>(std::move(statements));
 }
 
 Expr *Parser::parseUnary() {
@@ -828,7 +836,7 @@ Expr *Parser::parseUnary() {
       return nullptr;
     }
 
-    return new UnaryExpr(op, operand);
+    return this->arena.make<UnaryExpr>(op, operand);
   }
 
   return this->parsePrimary();
@@ -841,7 +849,7 @@ Statement *Parser::parseStructDecl() {
     return nullptr; // error
   }
 
-  std::string name = this->current.lexeme;
+  Symbol name = this->current.symbol;
   this->advance(); // consume struct name
 
   if (this->current.type != TokenType::LeftBrace) {
@@ -849,7 +857,7 @@ Statement *Parser::parseStructDecl() {
   }
   this->advance(); // consume '{'
 
-  std::vector<std::pair<std::string, std::string>> fields;
+  auto fields = this->arena.makeVector<std::pair<Symbol, const Type *>>();
 
   while (this->current.type != TokenType::RightBrace &&
          this->current.type != TokenType::EndOfFile) {
@@ -857,7 +865,7 @@ Statement *Parser::parseStructDecl() {
       return nullptr; // error
     }
 
-    std::string fieldName = this->current.lexeme;
+    Symbol fieldName = this->current.symbol;
     this->advance(); // consume field name
 
     if (this->current.type != TokenType::Colon) {
@@ -865,18 +873,11 @@ Statement *Parser::parseStructDecl() {
     }
     this->advance(); // consume ':'
 
-    if (this->current.type != TokenType::Identifier) {
+    const Type *fieldType = this->parseType();
+    if (!fieldType) {
       return nullptr; // error
     }
 
-    std::string fieldType = this->current.lexeme;
-    this->advance(); // consume field type
-
-    while (this->current.type == TokenType::Star) {
-      fieldType += "*";
-      this->advance();
-    }
-
     fields.push_back({fieldName, fieldType});
 
     if (this->current.type != TokenType::Semicolon) {
@@ -890,7 +891,7 @@ Statement *Parser::parseStructDecl() {
   }
   this->advance(); // consume '}'
 
-  return new StructDecl(name, fields, false);
+  return this->arena.make<StructDecl>(name, std::move(fields), false);
 }
 
 Statement *Parser::parseImportDecl() {
@@ -900,7 +901,7 @@ Statement *Parser::parseImportDecl() {
     return nullptr; // error
   }
 
-  std::string modulePath = this->current.lexeme;
+  std::string modulePath(this->current.lexeme);
   this->advance(); // consume module name
 
   while (this->current.type == TokenType::Dot) {
@@ -910,7 +911,8 @@ Statement *Parser::parseImportDecl() {
       return nullptr; // error
     }
 
-    modulePath += "/" + this->current.lexeme;
+    modulePath += "/";
+    modulePath += this->current.lexeme;
     this->advance(); // consume identifier
   }
 
@@ -920,5 +922,5 @@ Statement *Parser::parseImportDecl() {
 
   this->advance(); // consume ';'
 
-  return new ImportDecl(modulePath);
+  return this->arena.make<ImportDecl>(this->arena.copyString(modulePath));
 }
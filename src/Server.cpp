@@ -0,0 +1,291 @@
+#include "Server.hpp"
+
+#include <iostream>
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "ModuleMetadata.hpp"
+#include "ServerProtocol.hpp"
+
+extern char **environ;
+
+namespace {
+
+/// Modification time of the file at `path`, or 0 if it cannot be read.
+time_t getModificationTime(const std::string &path) {
+  struct stat info;
+  return ::stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+
+/// One compile request, as sent by raccoonc-client.
+struct Request {
+  std::vector<int> fds; // the client's stdout and stderr
+  std::string cwd;
+  std::vector<std::string> args = {"raccoonc"};
+  std::vector<std::string> env;
+};
+
+/// Read a request from `connection`. On failure, closes any descriptors
+/// that came with it and returns false.
+bool readRequest(int connection, Request &request) {
+  // A client that stalls must not hold up the accept loop for long.
+  timeval timeout = {5, 0};
+  ::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  server::RequestHeader header;
+  bool ok = server::receiveWithFds(connection, &header, sizeof(header),
+                                   request.fds, 2) &&
+            std::memcmp(header.magic, server::Magic, sizeof(header.magic)) ==
+                0 &&
+            header.version == server::Version && request.fds.size() == 2;
+
+  ok = ok && server::readString(connection, request.cwd);
+  for (uint32_t i = 0; ok && i < header.argCount; i++) {
+    ok = server::readString(connection, request.args.emplace_back());
+  }
+  for (uint32_t i = 0; ok && i < header.envCount; i++) {
+    ok = server::readString(connection, request.env.emplace_back());
+  }
+
+  if (!ok) {
+    for (int fd : request.fds) {
+      ::close(fd);
+    }
+  }
+  return ok;
+}
+
+/// Load the module interfaces `request` may import into the server, so that
+/// its worker and every later one inherit them instead of reading them
+/// again. Imports resolve below the directory of the file importing them, so
+/// that is every .racm under the directories of the .rac inputs, skipping
+/// hidden directories such as .racobj.
+void preloadInterfaces(const Request &request) {
+  std::set<std::string> dirs;
+  for (size_t i = 1; i < request.args.size(); i++) {
+    llvm::StringRef arg = request.args[i];
+    if (arg.starts_with("-") || !arg.ends_with(".rac")) {
+      continue;
+    }
+    llvm::SmallString<256> dir(arg);
+    llvm::sys::fs::make_absolute(request.cwd, dir);
+    llvm::sys::path::remove_filename(dir);
+    dirs.insert(std::string(dir));
+  }
+
+  for (const std::string &dir : dirs) {
+    std::error_code ec;
+    for (llvm::sys::fs::recursive_directory_iterator it(dir, ec), end;
+         it != end && !ec; it.increment(ec)) {
+      llvm::StringRef name = llvm::sys::path::filename(it->path());
+      if (name.starts_with(".")) {
+        it.no_push();
+      } else if (name.ends_with(".racm")) {
+        ModuleInterface::preload(it->path());
+      }
+    }
+  }
+}
+
+/// Run `request` in a worker process. Returns once the worker has exited
+/// and its status has been sent back over `connection`.
+void serveRequest(int connection, Request &request,
+                  CompileFunction compile) {
+  pid_t worker = ::fork();
+  if (worker == 0) {
+    ::dup2(request.fds[0], STDOUT_FILENO);
+    ::dup2(request.fds[1], STDERR_FILENO);
+    ::close(request.fds[0]);
+    ::close(request.fds[1]);
+    ::close(connection);
+    std::signal(SIGPIPE, SIG_DFL);
+
+    if (::chdir(request.cwd.c_str()) != 0) {
+      std::fprintf(stderr, "Error: Cannot change to directory '%s'\n",
+                   request.cwd.c_str());
+      ::_exit(1);
+    }
+
+    // Tools such as clang and the C compiler are looked up on the client's
+    // PATH, not on the one the server happened to start with.
+    std::vector<char *> envp;
+    for (auto &var : request.env) {
+      envp.push_back(var.data());
+    }
+    envp.push_back(nullptr);
+    environ = envp.data();
+
+    std::vector<const char *> argv;
+    for (const auto &arg : request.args) {
+      argv.push_back(arg.c_str());
+    }
+    argv.push_back(nullptr);
+
+    int status = compile(argv.size() - 1, argv.data());
+    std::cout.flush();
+    std::cerr.flush();
+    llvm::outs().flush();
+    llvm::errs().flush();
+    std::fflush(nullptr);
+    ::_exit(status);
+  }
+
+  ::close(request.fds[0]);
+  ::close(request.fds[1]);
+
+  int32_t exitStatus = 1;
+  int status;
+  if (worker > 0) {
+    while (::waitpid(worker, &status, 0) < 0 && errno == EINTR) {
+    }
+    exitStatus = WIFEXITED(status) ? WEXITSTATUS(status)
+                                   : 128 + WTERMSIG(status);
+  }
+  server::writeAll(connection, &exitStatus, sizeof(exitStatus));
+}
+
+} // namespace
+
+int runServer(const std::string &socketPath, const char *argv0,
+              CompileFunction compile) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Error: Socket path is too long: " << socketPath << "\n";
+    return 1;
+  }
+  std::strcpy(address.sun_path, socketPath.c_str());
+
+  int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    std::cerr << "Error: Cannot create socket: " << std::strerror(errno)
+              << "\n";
+    return 1;
+  }
+
+  // Replace a socket left behind by a server that died, but not a live one.
+  if (::connect(listener, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) == 0) {
+    std::cerr << "Error: A server is already listening on " << socketPath
+              << "\n";
+    ::close(listener);
+    return 1;
+  }
+  ::close(listener);
+  ::unlink(socketPath.c_str());
+
+  listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  mode_t oldMask = ::umask(0077); // only this user may connect
+  int bound = ::bind(listener, reinterpret_cast<sockaddr *>(&address),
+                     sizeof(address));
+  ::umask(oldMask);
+  if (bound != 0 || ::listen(listener, SOMAXCONN) != 0) {
+    std::cerr << "Error: Cannot listen on " << socketPath << ": "
+              << std::strerror(errno) << "\n";
+    ::close(listener);
+    return 1;
+  }
+
+  // A client that goes away must not kill the server.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  // Each compile already runs its modules in parallel, so more concurrent
+  // requests than cores only thrash. The rest wait in the listen backlog.
+  unsigned maxSupervisors = std::max(1u, std::thread::hardware_concurrency());
+  unsigned supervisors = 0;
+
+  // A server running a stale compiler would silently produce stale code, so
+  // it exits as soon as its executable is rebuilt; clients then fall back.
+  std::string executable = llvm::sys::fs::getMainExecutable(
+      argv0, reinterpret_cast<void *>(&runServer));
+  time_t executableTime = getModificationTime(executable);
+
+  std::cout << "Listening on " << socketPath << std::endl;
+
+  int result = 0;
+  for (;;) {
+    // Supervisors report to their clients themselves; here they are only
+    // reaped and counted.
+    while (supervisors > 0) {
+      int options = supervisors < maxSupervisors ? WNOHANG : 0;
+      pid_t done = ::waitpid(-1, nullptr, options);
+      if (done > 0) {
+        supervisors--;
+      } else if (done == 0 || errno != EINTR) {
+        break;
+      }
+    }
+
+    int connection = ::accept(listener, nullptr, nullptr);
+    if (connection < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      std::cerr << "Error: accept failed: " << std::strerror(errno) << "\n";
+      result = 1;
+      break;
+    }
+
+    if (getModificationTime(executable) != executableTime) {
+      ::close(connection);
+      std::cout << executable << " changed; shutting down" << std::endl;
+      break;
+    }
+
+    // Closing without a status tells the client to compile by itself.
+    Request request;
+    if (!readRequest(connection, request)) {
+      ::close(connection);
+      continue;
+    }
+    preloadInterfaces(request);
+
+    pid_t supervisor = ::fork();
+    if (supervisor == 0) {
+      ::close(listener);
+      serveRequest(connection, request, compile);
+      ::_exit(0);
+    }
+    for (int fd : request.fds) {
+      ::close(fd);
+    }
+    if (supervisor > 0) {
+      supervisors++;
+    }
+    ::close(connection);
+  }
+
+  ::close(listener);
+  ::unlink(socketPath.c_str());
+  return result;
+}
+
+#else
+
+int runServer(const std::string &socketPath, const char *argv0,
+              CompileFunction compile) {
+  std::cerr << "Error: --server is not supported on Windows\n";
+  return 1;
+}
+
+#endif // _WIN32
@@ -0,0 +1,134 @@
+#include "ServerProtocol.hpp"
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace server {
+
+std::string getSocketPath() {
+  if (const char *path = std::getenv("RACCOONC_SOCKET")) {
+    return path;
+  }
+  if (const char *runtimeDir = std::getenv("XDG_RUNTIME_DIR")) {
+    return std::string(runtimeDir) + "/raccoonc.sock";
+  }
+  return "/tmp/raccoonc-" + std::to_string(getuid()) + ".sock";
+}
+
+bool writeAll(int fd, const void *data, size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = ::write(fd, bytes, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool readAll(int fd, void *data, size_t size) {
+  char *bytes = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t count = ::read(fd, bytes, size);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    bytes += count;
+    size -= count;
+  }
+  return true;
+}
+
+bool writeString(int fd, const std::string &str) {
+  uint32_t size = str.size();
+  return writeAll(fd, &size, sizeof(size)) &&
+         writeAll(fd, str.data(), str.size());
+}
+
+bool readString(int fd, std::string &str) {
+  uint32_t size;
+  if (!readAll(fd, &size, sizeof(size))) {
+    return false;
+  }
+  str.resize(size);
+  return readAll(fd, str.data(), size);
+}
+
+bool sendWithFds(int socket, const void *data, size_t size,
+                 const std::vector<int> &fds) {
+  std::vector<char> control(CMSG_SPACE(fds.size() * sizeof(int)));
+  iovec iov = {const_cast<void *>(data), size};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), fds.data(), fds.size() * sizeof(int));
+
+  ssize_t sent;
+  do {
+    sent = ::sendmsg(socket, &msg, 0);
+  } while (sent < 0 && errno == EINTR);
+  if (sent < 0) {
+    return false;
+  }
+  // The descriptors went with the first byte; the rest is plain data.
+  const char *rest = static_cast<const char *>(data) + sent;
+  return writeAll(socket, rest, size - sent);
+}
+
+bool receiveWithFds(int socket, void *data, size_t size, std::vector<int> &fds,
+                    size_t maxFds) {
+  std::vector<char> control(CMSG_SPACE(maxFds * sizeof(int)));
+  iovec iov = {data, size};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  ssize_t received;
+  do {
+    received = ::recvmsg(socket, &msg, 0);
+  } while (received < 0 && errno == EINTR);
+  if (received <= 0) {
+    return false;
+  }
+
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    const int *attached = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+    fds.insert(fds.end(), attached, attached + count);
+  }
+
+  char *rest = static_cast<char *>(data) + received;
+  return readAll(socket, rest, size - received);
+}
+
+} // namespace server
+
+#endif // _WIN32
@@ -0,0 +1,105 @@
+#include "Symbol.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
+
+namespace {
+
+// Spellings are stored by id in fixed-size chunks that never move once
+// allocated, so str() can read them without a lock while other threads keep
+// interning (modules are lexed and generated concurrently under -j).
+constexpr uint32_t ChunkBits = 12;
+constexpr uint32_t ChunkSize = 1u << ChunkBits;
+constexpr uint32_t MaxChunks = 1u << 12;
+
+struct SymbolTable {
+  std::mutex mutex; // guards everything below except reads of names
+  // Owns the text; StringMap keys are stable and null-terminated.
+  llvm::StringMap<uint32_t> ids;
+  std::unique_ptr<std::string_view[]> names[MaxChunks];
+  uint32_t size = 1; // id 0 is the empty symbol
+  llvm::DenseMap<uint64_t, Symbol> mangled;
+
+  SymbolTable() { this->names[0].reset(new std::string_view[ChunkSize]); }
+
+  uint32_t internLocked(std::string_view text) {
+    auto [it, inserted] = this->ids.try_emplace(
+        llvm::StringRef(text.data(), text.size()), this->size);
+    if (inserted) {
+      uint32_t id = this->size++;
+      if ((id >> ChunkBits) >= MaxChunks) {
+        fprintf(stderr, "Error: Too many distinct identifiers\n");
+        std::abort();
+      }
+      auto &chunk = this->names[id >> ChunkBits];
+      if (!chunk) {
+        chunk.reset(new std::string_view[ChunkSize]);
+      }
+      chunk[id & (ChunkSize - 1)] =
+          std::string_view(it->getKeyData(), it->getKeyLength());
+    }
+    return it->getValue();
+  }
+};
+
+SymbolTable &symbolTable() {
+  static SymbolTable table;
+  return table;
+}
+
+} // namespace
+
+Symbol Symbol::intern(std::string_view text) {
+  if (text.empty()) {
+    return Symbol();
+  }
+
+  // The lexer interns every identifier it sees, so each thread keeps its own
+  // cache and only takes the table lock for spellings it has not seen yet.
+  thread_local llvm::StringMap<uint32_t> cache;
+  llvm::StringRef key(text.data(), text.size());
+  auto cached = cache.find(key);
+  if (cached != cache.end()) {
+    return Symbol(cached->getValue());
+  }
+
+  SymbolTable &table = symbolTable();
+  uint32_t id;
+  {
+    std::lock_guard<std::mutex> lock(table.mutex);
+    id = table.internLocked(text);
+  }
+  cache.try_emplace(key, id);
+  return Symbol(id);
+}
+
+Symbol Symbol::mangle(Symbol module, Symbol name) {
+  SymbolTable &table = symbolTable();
+  uint64_t key = (static_cast<uint64_t>(module.value) << 32) | name.value;
+
+  std::lock_guard<std::mutex> lock(table.mutex);
+  auto it = table.mangled.find(key);
+  if (it != table.mangled.end()) {
+    return it->second;
+  }
+
+  std::string text(module.str());
+  text += "_";
+  text += name.str();
+  Symbol result(table.internLocked(text));
+  table.mangled[key] = result;
+  return result;
+}
+
+std::string_view Symbol::str() const {
+  // Whoever handed us this Symbol got it from intern(), which published the
+  // slot under the lock, so no synchronisation is needed here.
+  return symbolTable().names[this->value >> ChunkBits]
+                            [this->value & (ChunkSize - 1)];
+}
@@ -0,0 +1,112 @@
+#include "Type.hpp"
+
+#include <new>
+
+const Type *Type::getBaseType() const {
+  const Type *type = this;
+  while (type->pointee) {
+    type = type->pointee;
+  }
+  return type;
+}
+
+std::string Type::str() const {
+  if (this->kind == Kind::Pointer) {
+    return this->pointee->str() + "*";
+  }
+
+  std::string spelling;
+  if (!this->module.empty()) {
+    spelling += this->module.str();
+    spelling += ".";
+  }
+  spelling += this->name.str();
+  return spelling;
+}
+
+TypeContext::TypeContext(Arena &arena) : arena(arena) {
+  this->voidType = this->addPrimitive("void", Type::Kind::Void);
+  this->boolType = this->addPrimitive("bool", Type::Kind::Bool);
+  this->charType = this->addPrimitive("char", Type::Kind::Char);
+
+  this->addPrimitive("i8", Type::Kind::Int, 8);
+  this->addPrimitive("i16", Type::Kind::Int, 16);
+  this->i32Type = this->addPrimitive("i32", Type::Kind::Int, 32);
+  this->addPrimitive("i64", Type::Kind::Int, 64);
+  this->addPrimitive("i128", Type::Kind::Int, 128);
+
+  this->addPrimitive("u8", Type::Kind::Int, 8, false);
+  this->addPrimitive("u16", Type::Kind::Int, 16, false);
+  this->addPrimitive("u32", Type::Kind::Int, 32, false);
+  this->addPrimitive("u64", Type::Kind::Int, 64, false);
+  this->addPrimitive("u128", Type::Kind::Int, 128, false);
+  // TODO: Use data layout for actual pointer size
+  this->addPrimitive("usize", Type::Kind::Int, 64, false);
+
+  this->f32Type = this->addPrimitive("f32", Type::Kind::Float, 32);
+  this->addPrimitive("f64", Type::Kind::Float, 64);
+}
+
+const Type *TypeContext::addPrimitive(std::string_view spelling,
+                                      Type::Kind kind, unsigned bits,
+                                      bool isSigned) {
+  Symbol name = Symbol::intern(spelling);
+  void *mem = this->arena.allocate(sizeof(Type), alignof(Type));
+  const Type *type = new (mem) Type(kind, name, bits, isSigned);
+  this->named[name] = type;
+  return type;
+}
+
+const Type *TypeContext::getNamed(Symbol name) {
+  const Type *&slot = this->named[name];
+  if (!slot) {
+    // Anything that is not a primitive names a struct; Codegen decides later
+    // whether it exists.
+    void *mem = this->arena.allocate(sizeof(Type), alignof(Type));
+    slot = new (mem) Type(Type::Kind::Struct, name);
+  }
+  return slot;
+}
+
+const Type *TypeContext::getQualified(Symbol module, Symbol name) {
+  const Type *&slot = this->qualified[{module, name}];
+  if (!slot) {
+    void *mem = this->arena.allocate(sizeof(Type), alignof(Type));
+    Type *type = new (mem) Type(Type::Kind::Struct, name);
+    type->module = module;
+    slot = type;
+  }
+  return slot;
+}
+
+const Type *TypeContext::getPointerTo(const Type *pointee) {
+  if (!pointee->pointerTo) {
+    void *mem = this->arena.allocate(sizeof(Type), alignof(Type));
+    Type *type = new (mem) Type(Type::Kind::Pointer, Symbol());
+    type->pointee = pointee;
+    pointee->pointerTo = type;
+  }
+  return pointee->pointerTo;
+}
+
+const Type *TypeContext::parse(std::string_view spelling) {
+  size_t stars = 0;
+  while (!spelling.empty() && spelling.back() == '*') {
+    spelling.remove_suffix(1);
+    stars++;
+  }
+
+  const Type *type;
+  size_t dotPos = spelling.find('.');
+  if (dotPos != std::string_view::npos) {
+    type = this->getQualified(Symbol::intern(spelling.substr(0, dotPos)),
+                              Symbol::intern(spelling.substr(dotPos + 1)));
+  } else {
+    type = this->getNamed(Symbol::intern(spelling));
+  }
+
+  for (size_t i = 0; i < stars; i++) {
+    type = this->getPointerTo(type);
+  }
+  return type;
+}
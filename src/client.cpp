@@ -0,0 +1,112 @@
+// raccoonc-client: a thin front end for `raccoonc --server`.
+//
+// Forwards its arguments, working directory, environment, stdout and stderr
+// to the server and exits with the status of the compile. If no server
+// answers, it runs the raccoonc next to it (or on PATH) with the same
+// arguments instead, so build systems can always invoke the client.
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+#include "ServerProtocol.hpp"
+
+#ifndef _WIN32
+extern char **environ;
+
+/// Run the compile on the server. Returns false if there is no server or it
+/// did not report a status.
+bool compileOnServer(int argc, char *argv[], int &status) {
+  std::string socketPath = server::getSocketPath();
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::strcpy(address.sun_path, socketPath.c_str());
+
+  int connection = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connection < 0) {
+    return false;
+  }
+  if (::connect(connection, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) != 0) {
+    ::close(connection);
+    return false;
+  }
+
+  std::vector<char> cwd(4096);
+  while (!::getcwd(cwd.data(), cwd.size()) && errno == ERANGE) {
+    cwd.resize(cwd.size() * 2);
+  }
+
+  // A server that refuses the request just closes the connection; that must
+  // not kill us before we can fall back.
+  auto previousHandler = std::signal(SIGPIPE, SIG_IGN);
+
+  server::RequestHeader header;
+  std::memcpy(header.magic, server::Magic, sizeof(header.magic));
+  header.version = server::Version;
+  header.argCount = argc - 1;
+  header.envCount = 0;
+  for (char **env = environ; *env; env++) {
+    header.envCount++;
+  }
+
+  bool ok = server::sendWithFds(connection, &header, sizeof(header),
+                                {STDOUT_FILENO, STDERR_FILENO}) &&
+            server::writeString(connection, cwd.data());
+  for (int i = 1; ok && i < argc; i++) {
+    ok = server::writeString(connection, argv[i]);
+  }
+  for (char **env = environ; ok && *env; env++) {
+    ok = server::writeString(connection, *env);
+  }
+
+  int32_t result;
+  ok = ok && server::readAll(connection, &result, sizeof(result));
+  ::close(connection);
+  std::signal(SIGPIPE, previousHandler);
+  if (ok) {
+    status = result;
+  }
+  return ok;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+#ifndef _WIN32
+  int status;
+  if (compileOnServer(argc, argv, status)) {
+    return status;
+  }
+#endif
+
+  std::string self = argv[0];
+  size_t slash = self.find_last_of("/\\");
+  std::string compiler = slash == std::string::npos
+                             ? "raccoonc"
+                             : self.substr(0, slash + 1) + "raccoonc";
+
+  std::vector<char *> args(argv, argv + argc + 1);
+  args[0] = compiler.data();
+#ifdef _WIN32
+  _execvp(compiler.c_str(), args.data());
+#else
+  ::execvp(compiler.c_str(), args.data());
+#endif
+  std::cerr << "Error: Cannot run " << compiler << ": " << std::strerror(errno)
+            << "\n";
+  return 1;
+}
@@ -1,38 +1,82 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <filesystem>
-#include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "AST.hpp"
+#include "ASTVisitor.hpp"
+#include "Arena.hpp"
+#include "BuildState.hpp"
 #include "Codegen.hpp"
 #include "Lexer.hpp"
 #include "Parser.hpp"
+#include "Server.hpp"
+#include "ServerProtocol.hpp"
 
 namespace fs = std::filesystem;
 
+#ifndef RACCOON_VERSION
+#define RACCOON_VERSION "dev"
+#endif
+
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/Analysis/CGSCCPassManager.h>
 #include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/LTO/LTO.h>
+#include <llvm/Linker/Linker.h>
 #include <llvm/MC/TargetRegistry.h>
+#include <llvm/Object/ObjectFile.h>
 #include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/Caching.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Program.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/TimeProfiler.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/TargetParser/Host.h>
 #include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/Internalize.h>
 #include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Scalar/GVN.h>
 
+#ifdef RACCOON_HAVE_LLD
+#include <lld/Common/Driver.h>
+LLD_HAS_DRIVER(elf)
+#endif
+
+/// How the Raccoon modules of a program are optimized (--lto).
+enum class LTOMode {
+  None, // each module is optimized and emitted on its own
+  Full, // modules are merged and optimized as one before emission
+  Thin, // modules are optimized in parallel using summaries of the others
+};
+
 struct CompilerOptions {
   std::vector<std::string> sourceFiles;
   std::vector<std::string> cSourceFiles;
@@ -41,15 +85,27 @@ struct CompilerOptions {
   std::vector<std::string> libraryPaths;
   std::string outputFile = "a.out";
   std::string targetTriple = llvm::sys::getDefaultTargetTriple();
+  std::string cpu = "generic";
+  std::string features; // comma-separated, e.g. "+avx2,+fma"
+  bool nativeCPU = false; // -march=native: cpu and features are the host's
   bool bareMetal = false;
   bool emitLLVM = false;
   bool emitObject = false;
   bool noLink = false;
   int optLevel = 0;
+  bool optimizeForDebug = false; // -Og: optLevel 1 with a cheap pipeline
   bool generateDebugInfo = false;
   bool verbose = false;
   bool quiet = false;
   bool forceRecompile = false;
+  bool printStats = false;
+  bool emitRacmText = false;
+  bool useLLD = false;
+  LTOMode lto = LTOMode::None;
+  std::string thinLTOCacheDir;
+  std::string timeTraceFile;
+  unsigned timeTraceGranularity = 500; // microseconds
+  unsigned jobs = 1;
 };
 std::string getObjectFileName(const std::string &outputFile) {
   fs::path p(outputFile);
@@ -96,17 +152,32 @@ std::string getBaseName(const std::string &filepath) {
   return p.stem().string();
 }
 
+/// Top-level scan the driver needs before codegen: import paths and whether
+/// the unit exports anything.
+struct UnitScanner : StmtVisitor<UnitScanner> {
+  std::vector<std::string> imports;
+  bool hasExports = false;
+
+  void visitImportDecl(ImportDecl *importDecl) {
+    this->imports.emplace_back(importDecl->modulePath);
+  }
+  void visitFunctionDecl(FunctionDecl *funcDecl) {
+    this->hasExports |= funcDecl->isExported;
+  }
+  void visitStructDecl(StructDecl *structDecl) {
+    this->hasExports |= structDecl->isExported;
+  }
+};
+
 std::vector<std::string>
 extractImports(const std::vector<Statement *> &program) {
-  std::vector<std::string> imports;
+  UnitScanner scanner;
 
   for (auto *stmt : program) {
-    if (auto *importDecl = dynamic_cast<ImportDecl *>(stmt)) {
-      imports.push_back(importDecl->modulePath);
-    }
+    scanner.visitStmt(stmt);
   }
 
-  return imports;
+  return std::move(scanner.imports);
 }
 
 bool fileExists(const std::string &filePath) { return fs::exists(filePath); }
@@ -118,15 +189,12 @@ std::string getMetadataPath(const std::string &sourceFile) {
 }
 
 bool hasExports(const std::vector<Statement *> &program) {
+  UnitScanner scanner;
+
   for (auto *stmt : program) {
-    if (auto *funcDecl = dynamic_cast<FunctionDecl *>(stmt)) {
-      if (funcDecl->isExported)
-        return true;
-    }
-    if (auto *structDecl = dynamic_cast<StructDecl *>(stmt)) {
-      if (structDecl->isExported)
-        return true;
-    }
+    scanner.visitStmt(stmt);
+    if (scanner.hasExports)
+      return true;
   }
   return false;
 }
@@ -142,167 +210,696 @@ long getFileModificationTime(const std::string &filePath) {
   }
 }
 
-bool needsRecompilation(const std::string &sourceFile,
-                        const std::string &objectFile, bool forceRecompile) {
-  if (forceRecompile)
-    return true;
-  if (!fileExists(objectFile))
-    return true;
+/// Where the driver records what each object file was built from.
+const char *const BuildStateFile = ".racbuild";
+
+/// Identifies this build of raccoonc by the size and modification time of
+/// its executable. RACCOON_VERSION stays the same across rebuilds that
+/// change the IR Codegen emits, so it cannot tell two builds apart.
+const std::string &getCompilerFingerprint() {
+  static const std::string fingerprint = [] {
+    std::string executable = llvm::sys::fs::getMainExecutable(
+        nullptr, reinterpret_cast<void *>(&getCompilerFingerprint));
+    llvm::sys::fs::file_status status;
+    if (executable.empty() || llvm::sys::fs::status(executable, status)) {
+      // Nothing to recognize this build by later, so match no other run.
+      return "unknown " + std::to_string(std::chrono::system_clock::now()
+                                             .time_since_epoch()
+                                             .count());
+    }
+    return std::to_string(status.getSize()) + " " +
+           std::to_string(
+               status.getLastModificationTime().time_since_epoch().count());
+  }();
+  return fingerprint;
+}
+
+/// Hash of everything besides the sources that shapes a unit's unoptimized
+/// IR: the compiler itself and the options Codegen looks at.
+uint64_t hashFrontendConfiguration(const CompilerOptions &opts) {
+  std::string config = "raccoonc " RACCOON_VERSION " llvm " LLVM_VERSION_STRING
+                       " racm " +
+                       std::to_string(racm::Version) + "\n";
+  config += "build " + getCompilerFingerprint() + "\n";
+  config += "debug " + std::to_string(opts.generateDebugInfo) + "\n";
+  return BuildState::hash(config);
+}
+
+/// Hash of the options that only affect how IR becomes an object file. When
+/// just these change, units are rebuilt from their cached IR.
+uint64_t hashConfiguration(const CompilerOptions &opts) {
+  std::string config = "target " + opts.targetTriple + "\n";
+  config += "bare-metal " + std::to_string(opts.bareMetal) + "\n";
+  config += "cpu " + opts.cpu + "\n";
+  config += "features " + opts.features + "\n";
+  config += "opt " + std::to_string(opts.optLevel) +
+            (opts.optimizeForDebug ? "g" : "") + "\n";
+  config += "lto " + std::to_string(static_cast<int>(opts.lto)) + "\n";
+  return BuildState::hash(config);
+}
+
+/// Console output of one compilation unit. Under -j several modules are
+/// compiled at once, so each writes into its own buffers and the driver
+/// prints them in import order, whatever the job count.
+struct UnitOutput {
+  std::ostringstream out;
+  std::ostringstream err;
+};
+
+/// Where this thread's driver output goes; null means straight to the
+/// console.
+thread_local UnitOutput *currentOutput = nullptr;
 
-  long sourceTime = getFileModificationTime(sourceFile);
-  long objectTime = getFileModificationTime(objectFile);
+/// Sends this thread's driver output to `output` while in scope.
+class OutputScope {
+public:
+  explicit OutputScope(UnitOutput &output) : saved(currentOutput) {
+    currentOutput = &output;
+  }
+  ~OutputScope() { currentOutput = this->saved; }
+
+private:
+  UnitOutput *saved;
+};
+
+/// Print and clear buffered output.
+void printOutput(UnitOutput &output) {
+  std::cout << output.out.str();
+  std::cerr << output.err.str();
+  output = UnitOutput();
+}
+
+std::ostream &outStream() {
+  return currentOutput ? currentOutput->out : std::cout;
+}
 
-  return sourceTime > objectTime;
+std::ostream &errStream() {
+  return currentOutput ? currentOutput->err : std::cerr;
 }
 
 void log(const CompilerOptions &opts, const std::string &message) {
   if (!opts.quiet) {
-    std::cout << message << "\n";
+    outStream() << message << "\n";
   }
 }
 
 void logVerbose(const CompilerOptions &opts, const std::string &message) {
   if (opts.verbose && !opts.quiet) {
-    std::cout << "[VERBOSE] " << message << "\n";
+    outStream() << "[VERBOSE] " << message << "\n";
   }
 }
 
-bool emitObjectFile(llvm::Module *module, const std::string &filename,
-                    const CompilerOptions &opts) {
-  llvm::InitializeAllTargetInfos();
-  llvm::InitializeAllTargets();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllAsmParsers();
-  llvm::InitializeAllAsmPrinters();
+void logStats(const CompilerOptions &opts, const std::string &message) {
+  if (opts.printStats) {
+    outStream() << "[STATS] " << message << "\n";
+  }
+}
 
-  llvm::Triple targetTriple(opts.targetTriple);
-  if (opts.bareMetal) {
-    module->setTargetTriple(llvm::Triple("x86_64-pc-none-elf"));
-  } else {
-    module->setTargetTriple(targetTriple);
+std::string elapsedMillis(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::ostringstream out;
+  out.setf(std::ios::fixed);
+  out.precision(2);
+  out << elapsed.count() << " ms";
+  return out.str();
+}
+
+/// Under --time-trace, gives the calling thread a profiler of its own for
+/// the lifetime of this object, unless it already has one. Its events join
+/// the main thread's trace when the object is destroyed. Every task run on a
+/// thread pool starts with one of these.
+class TimeTraceThread {
+public:
+  explicit TimeTraceThread(const CompilerOptions &opts) {
+    if (!opts.timeTraceFile.empty() && !llvm::timeTraceProfilerEnabled()) {
+      // Names the thread's track in the trace viewer.
+      llvm::set_thread_name("raccoonc-worker");
+      llvm::timeTraceProfilerInitialize(opts.timeTraceGranularity, "raccoonc");
+      this->owned = true;
+    }
+  }
+  ~TimeTraceThread() {
+    if (this->owned) {
+      llvm::timeTraceProfilerFinishThread();
+    }
+  }
+
+  TimeTraceThread(const TimeTraceThread &) = delete;
+  TimeTraceThread &operator=(const TimeTraceThread &) = delete;
+
+private:
+  bool owned = false;
+};
+
+/// Under --time-trace, profiles the main thread for the lifetime of this
+/// object, then writes the events of every thread to the requested file as
+/// Chrome trace-event JSON, for chrome://tracing or ui.perfetto.dev.
+class TimeTraceSession {
+public:
+  explicit TimeTraceSession(const CompilerOptions &opts) : opts(opts) {
+    if (!opts.timeTraceFile.empty()) {
+      llvm::timeTraceProfilerInitialize(opts.timeTraceGranularity, "raccoonc");
+    }
+  }
+  ~TimeTraceSession() {
+    if (!llvm::timeTraceProfilerEnabled()) {
+      return;
+    }
+    std::error_code ec;
+    llvm::raw_fd_ostream out(this->opts.timeTraceFile, ec,
+                             llvm::sys::fs::OF_Text);
+    if (ec) {
+      std::cerr << "Error: Cannot write time trace to "
+                << this->opts.timeTraceFile << ": " << ec.message() << "\n";
+    } else {
+      llvm::timeTraceProfilerWrite(out);
+      log(this->opts, "Time trace written to " + this->opts.timeTraceFile);
+    }
+    llvm::timeTraceProfilerCleanup();
+  }
+
+  TimeTraceSession(const TimeTraceSession &) = delete;
+  TimeTraceSession &operator=(const TimeTraceSession &) = delete;
+
+private:
+  const CompilerOptions &opts;
+};
+
+/// Find the LLVM target for `targetTriple`, registering targets the first
+/// time they are needed. Registering all of them costs more than the rest of
+/// a small compile, so when the triple is for the host architecture only the
+/// native target is registered, and everything else only if that fails.
+/// LLVM's registry is not thread-safe, so this serialises its callers.
+const llvm::Target *findTarget(const llvm::Triple &targetTriple,
+                               std::string &error) {
+  static std::mutex mutex;
+  static bool nativeRegistered = false;
+  static bool allRegistered = false;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  llvm::Triple host(llvm::sys::getProcessTriple());
+  if (!nativeRegistered && targetTriple.getArch() == host.getArch()) {
+    nativeRegistered = true;
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
   }
 
-  std::string error;
   const llvm::Target *target =
       llvm::TargetRegistry::lookupTarget(targetTriple, error);
-
-  if (!target) {
-    llvm::errs() << "Error: " << error << "\n";
-    return false;
+  if (!target && !allRegistered) {
+    allRegistered = true;
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmParsers();
+    llvm::InitializeAllAsmPrinters();
+    error.clear();
+    target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
   }
+  return target;
+}
 
-  std::string cpu = "generic";
-  std::string features = "";
-  llvm::TargetOptions opt;
+/// This thread's TargetMachine for the given configuration, created on first
+/// use. A TargetMachine can emit any number of modules, one at a time, so
+/// each worker thread keeps one per configuration for the whole build.
+/// Sets `created` if this call had to create it.
+llvm::TargetMachine *
+getTargetMachine(const llvm::Target *target, const llvm::Triple &targetTriple,
+                 const std::string &cpu, const std::string &features,
+                 llvm::Reloc::Model relocModel,
+                 llvm::CodeGenOptLevel codegenOptLevel, bool &created) {
+  thread_local std::map<std::string, std::unique_ptr<llvm::TargetMachine>>
+      cache;
+
+  std::string key = targetTriple.str() + '\0' + cpu + '\0' + features +
+                    '\0' + std::to_string(relocModel) + '\0' +
+                    std::to_string(static_cast<int>(codegenOptLevel));
+  std::unique_ptr<llvm::TargetMachine> &slot = cache[key];
+  created = !slot;
+  if (!slot) {
+    llvm::TargetOptions opt;
+    slot.reset(target->createTargetMachine(targetTriple, cpu, features, opt,
+                                           relocModel, std::nullopt,
+                                           codegenOptLevel));
+  }
+  return slot.get();
+}
 
-  llvm::CodeGenOptLevel codegenOptLevel;
+llvm::CodeGenOptLevel getCodeGenOptLevel(const CompilerOptions &opts) {
   switch (opts.optLevel) {
-  case 0:
-    codegenOptLevel = llvm::CodeGenOptLevel::None;
-    break;
   case 1:
-    codegenOptLevel = llvm::CodeGenOptLevel::Less;
-    break;
+    return llvm::CodeGenOptLevel::Less;
   case 2:
-    codegenOptLevel = llvm::CodeGenOptLevel::Default;
-    break;
+    return llvm::CodeGenOptLevel::Default;
   case 3:
-    codegenOptLevel = llvm::CodeGenOptLevel::Aggressive;
-    break;
+    return llvm::CodeGenOptLevel::Aggressive;
   default:
-    codegenOptLevel = llvm::CodeGenOptLevel::None;
-    break;
+    return llvm::CodeGenOptLevel::None;
   }
+}
 
-  llvm::TargetMachine *targetMachine = nullptr;
+llvm::Reloc::Model getRelocModel(const CompilerOptions &opts) {
+  return opts.bareMetal ? llvm::Reloc::Static : llvm::Reloc::PIC_;
+}
+
+/// Set the module's target triple and data layout, and return this thread's
+/// TargetMachine for the build's target. Returns nullptr after reporting an
+/// error.
+llvm::TargetMachine *prepareModule(llvm::Module *module,
+                                   const CompilerOptions &opts) {
+  auto setupStart = std::chrono::steady_clock::now();
+
+  llvm::Triple targetTriple(opts.targetTriple);
   if (opts.bareMetal) {
-    targetMachine = target->createTargetMachine(targetTriple, cpu, features,
-                                                opt, llvm::Reloc::Static,
-                                                std::nullopt, codegenOptLevel);
+    module->setTargetTriple(llvm::Triple("x86_64-pc-none-elf"));
   } else {
-    targetMachine = target->createTargetMachine(targetTriple, cpu, features,
-                                                opt, llvm::Reloc::PIC_,
-                                                std::nullopt, codegenOptLevel);
+    module->setTargetTriple(targetTriple);
+  }
+
+  // @target_clones dispatches through an ELF ifunc and libgcc's CPU model.
+  if (!module->ifunc_empty() &&
+      (opts.bareMetal || !targetTriple.isX86() ||
+       !targetTriple.isOSBinFormatELF())) {
+    errStream() << "Error: @target_clones is only supported on x86 ELF "
+                   "targets\n";
+    return nullptr;
   }
 
+  std::string error;
+  const llvm::Target *target = findTarget(targetTriple, error);
+
+  if (!target) {
+    errStream() << "Error: " << error << "\n";
+    return nullptr;
+  }
+
+  bool created = false;
+  llvm::TargetMachine *targetMachine = getTargetMachine(
+      target, targetTriple, opts.cpu, opts.features, getRelocModel(opts),
+      getCodeGenOptLevel(opts), created);
+
   if (!targetMachine) {
-    llvm::errs() << "Error: Could not create target machine\n";
-    return false;
+    errStream() << "Error: Could not create target machine\n";
+    return nullptr;
   }
+  logVerbose(opts, std::string(created ? "Created" : "Reused") +
+                       " target machine in " + elapsedMillis(setupStart));
 
   module->setDataLayout(targetMachine->createDataLayout());
+  Codegen::addTargetAttributes(*module);
 
-  if (opts.optLevel > 0) {
-    logVerbose(opts, "Applying optimization passes (level " +
-                         std::to_string(opts.optLevel) + ")");
-
-    llvm::LoopAnalysisManager LAM;
-    llvm::FunctionAnalysisManager FAM;
-    llvm::CGSCCAnalysisManager CGAM;
-    llvm::ModuleAnalysisManager MAM;
-
-    llvm::PassBuilder PB;
-    PB.registerModuleAnalyses(MAM);
-    PB.registerCGSCCAnalyses(CGAM);
-    PB.registerFunctionAnalyses(FAM);
-    PB.registerLoopAnalyses(LAM);
-    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
-
-    llvm::ModulePassManager MPM;
-
-    switch (opts.optLevel) {
-    case 1:
-      MPM = PB.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O1);
-      break;
-    case 2:
-      MPM = PB.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
-      break;
-    case 3:
-      MPM = PB.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3);
-      break;
-    default:
-      MPM = PB.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O0);
-      break;
+  // The optimizer's cost models look at the function, not the
+  // TargetMachine, so the CPU has to be recorded on every definition.
+  for (llvm::Function &function : *module) {
+    if (function.isDeclaration()) {
+      continue;
     }
+    function.addFnAttr("target-cpu", opts.cpu);
+    // Set from scratch: merged --lto=full modules come through here twice.
+    std::string features = opts.features;
+    if (function.hasFnAttribute("raccoon.clone_features")) {
+      // A @target_clones clone: its own features go last so they win.
+      llvm::StringRef own =
+          function.getFnAttribute("raccoon.clone_features").getValueAsString();
+      features += (features.empty() ? "" : ",") + own.str();
+    }
+    if (features.empty()) {
+      function.removeFnAttr("target-features");
+    } else {
+      function.addFnAttr("target-features", features);
+    }
+  }
+  return targetMachine;
+}
+
+/// The optimization pipelines the driver runs.
+enum class Pipeline {
+  PerModule,    // a module compiled to an object file on its own
+  FullPreLink,  // a module compiled to bitcode for --lto=full
+  FullPostLink, // the merged program under --lto=full
+  ThinPreLink,  // a module compiled to bitcode for --lto=thin
+};
+
+void optimizeModule(llvm::Module *module, llvm::TargetMachine *targetMachine,
+                    Pipeline pipeline, const CompilerOptions &opts) {
+  if (opts.optLevel == 0) {
+    return;
+  }
+  logVerbose(opts, "Applying optimization passes (level " +
+                       (opts.optimizeForDebug
+                            ? std::string("g")
+                            : std::to_string(opts.optLevel)) +
+                       ")");
+
+  llvm::TimeTraceScope timeScope("Optimize", module->getModuleIdentifier());
+
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+
+  // Under --time-trace, one span per pass run, tagged with the module.
+  llvm::PassInstrumentationCallbacks PIC;
+  if (llvm::timeTraceProfilerEnabled()) {
+    std::string moduleName = module->getModuleIdentifier();
+    PIC.registerBeforeNonSkippedPassCallback(
+        [moduleName](llvm::StringRef pass, llvm::Any) {
+          llvm::timeTraceProfilerBegin(pass, moduleName);
+        });
+    PIC.registerAfterPassCallback(
+        [](llvm::StringRef, llvm::Any, const llvm::PreservedAnalyses &) {
+          llvm::timeTraceProfilerEnd();
+        });
+    PIC.registerAfterPassInvalidatedCallback(
+        [](llvm::StringRef, const llvm::PreservedAnalyses &) {
+          llvm::timeTraceProfilerEnd();
+        });
+  }
 
+  llvm::PassBuilder PB(targetMachine, llvm::PipelineTuningOptions(),
+                       std::nullopt, &PIC);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  llvm::ModulePassManager MPM;
+  if (opts.optimizeForDebug) {
+    // -Og: only the cheap cleanups that undo most of what -O0 leaves
+    // behind, whichever stage of the build this is.
+    llvm::cantFail(PB.parsePassPipeline(
+        MPM, "always-inline,function(mem2reg,sroa,early-cse,instcombine,"
+             "simplifycfg)"));
     MPM.run(*module, MAM);
+    return;
   }
 
+  llvm::OptimizationLevel level;
+  switch (opts.optLevel) {
+  case 1:
+    level = llvm::OptimizationLevel::O1;
+    break;
+  case 2:
+    level = llvm::OptimizationLevel::O2;
+    break;
+  default:
+    level = llvm::OptimizationLevel::O3;
+    break;
+  }
+
+  switch (pipeline) {
+  case Pipeline::PerModule:
+    MPM = PB.buildPerModuleDefaultPipeline(level);
+    break;
+  case Pipeline::FullPreLink:
+    MPM = PB.buildLTOPreLinkDefaultPipeline(level);
+    break;
+  case Pipeline::FullPostLink:
+    MPM = PB.buildLTODefaultPipeline(level, nullptr);
+    break;
+  case Pipeline::ThinPreLink:
+    MPM = PB.buildThinLTOPreLinkDefaultPipeline(level);
+    break;
+  }
+
+  MPM.run(*module, MAM);
+}
+
+bool writeObjectFile(llvm::Module *module, llvm::TargetMachine *targetMachine,
+                     const std::string &filename) {
+  llvm::TimeTraceScope timeScope("EmitObject", filename);
   std::error_code ec;
   llvm::raw_fd_ostream dest(filename, ec, llvm::sys::fs::OF_None);
 
   if (ec) {
-    llvm::errs() << "Error: Could not open file: " << ec.message() << "\n";
+    errStream() << "Error: Could not open file: " << ec.message() << "\n";
     return false;
   }
 
   llvm::legacy::PassManager pass;
   if (targetMachine->addPassesToEmitFile(pass, dest, nullptr,
                                          llvm::CodeGenFileType::ObjectFile)) {
-    llvm::errs() << "Error: Target machine can't emit a file of this type\n";
+    errStream() << "Error: Target machine can't emit a file of this type\n";
     return false;
   }
 
   pass.run(*module);
   dest.flush();
+  return true;
+}
+
+bool emitObjectFile(llvm::Module *module, const std::string &filename,
+                    const CompilerOptions &opts) {
+  llvm::TargetMachine *targetMachine = prepareModule(module, opts);
+  if (!targetMachine) {
+    return false;
+  }
 
+  auto emitStart = std::chrono::steady_clock::now();
+  optimizeModule(module, targetMachine, Pipeline::PerModule, opts);
+  if (!writeObjectFile(module, targetMachine, filename)) {
+    return false;
+  }
+
+  logVerbose(opts, "Optimized and emitted in " + elapsedMillis(emitStart));
   log(opts, "Object file written to " + filename);
+  return true;
+}
+
+/// Under --lto, run the pre-link pipeline and write bitcode for the LTO link
+/// instead of an object file. For ThinLTO the bitcode carries the module's
+/// summary and a hash of its contents, which keys the backend cache.
+bool emitBitcodeFile(llvm::Module *module, const std::string &filename,
+                     const CompilerOptions &opts) {
+  llvm::TargetMachine *targetMachine = prepareModule(module, opts);
+  if (!targetMachine) {
+    return false;
+  }
+
+  auto emitStart = std::chrono::steady_clock::now();
+  bool thin = opts.lto == LTOMode::Thin;
+  optimizeModule(module, targetMachine,
+                 thin ? Pipeline::ThinPreLink : Pipeline::FullPreLink, opts);
+
+  llvm::TimeTraceScope timeScope("EmitBitcode", filename);
+  std::error_code ec;
+  llvm::raw_fd_ostream dest(filename, ec, llvm::sys::fs::OF_None);
+  if (ec) {
+    errStream() << "Error: Could not open file: " << ec.message() << "\n";
+    return false;
+  }
+  if (thin) {
+    llvm::ProfileSummaryInfo profile(*module);
+    llvm::ModuleSummaryIndex summary =
+        llvm::buildModuleSummaryIndex(*module, nullptr, &profile);
+    llvm::WriteBitcodeToFile(*module, dest, false, &summary,
+                             /*GenerateHash=*/true);
+  } else {
+    llvm::WriteBitcodeToFile(*module, dest);
+  }
+  dest.flush();
 
-  delete targetMachine;
+  logVerbose(opts, "Optimized and emitted in " + elapsedMillis(emitStart));
+  log(opts, "Bitcode file written to " + filename);
   return true;
 }
 
+/// Whether clang is on PATH, so it can drive C compiles and the link. Looked
+/// up once per process, without running it.
+bool hasClang() {
+#ifdef _WIN32
+  static const bool found = bool(llvm::sys::findProgramByName("clang.exe"));
+#else
+  static const bool found = bool(llvm::sys::findProgramByName("clang"));
+#endif
+  return found;
+}
+
+#ifdef RACCOON_HAVE_LLD
+/// Split one command line as printed by `clang -###`: every argument in
+/// double quotes, with backslash escapes.
+std::vector<std::string> splitDriverCommand(llvm::StringRef line) {
+  std::vector<std::string> args;
+  size_t i = 0;
+  while (i < line.size()) {
+    if (line[i] == ' ') {
+      i++;
+      continue;
+    }
+    std::string arg;
+    bool quoted = line[i] == '"';
+    if (quoted) {
+      i++;
+    }
+    for (; i < line.size(); i++) {
+      char c = line[i];
+      if (quoted && c == '\\' && i + 1 < line.size()) {
+        arg += line[++i];
+      } else if (quoted ? c == '"' : c == ' ') {
+        i++;
+        break;
+      } else {
+        arg += c;
+      }
+    }
+    args.push_back(std::move(arg));
+  }
+  return args;
+}
+
+/// What the clang driver links into an executable besides the program's own
+/// objects (start files, libc, the dynamic loader): its linker command for a
+/// placeholder object, and where the object and the output name go.
+struct LinkPlan {
+  std::vector<std::string> args;
+  size_t inputIndex;
+  size_t outputIndex;
+};
+
+/// Ask `clang` for its link plan for `triple` by running it with -### once.
+std::optional<LinkPlan> planLink(const std::string &clang,
+                                 const std::string &triple) {
+  // The driver wants its inputs to exist, but -### never reads them.
+  llvm::SmallString<128> input, planFile;
+  if (llvm::sys::fs::createTemporaryFile("raccoon-plan", "o", input)) {
+    return std::nullopt;
+  }
+  if (llvm::sys::fs::createTemporaryFile("raccoon-link", "txt", planFile)) {
+    llvm::sys::fs::remove(input);
+    return std::nullopt;
+  }
+  const std::string output = "raccoon-plan-output";
+  const std::string target = "--target=" + triple;
+
+  llvm::StringRef driverArgs[] = {clang, target, "-###", input, "-o", output};
+  std::optional<llvm::StringRef> redirects[] = {std::nullopt, std::nullopt,
+                                                llvm::StringRef(planFile)};
+  int status =
+      llvm::sys::ExecuteAndWait(clang, driverArgs, std::nullopt, redirects);
+  auto plan = llvm::MemoryBuffer::getFile(planFile);
+  llvm::sys::fs::remove(input);
+  llvm::sys::fs::remove(planFile);
+  if (status != 0 || !plan) {
+    return std::nullopt;
+  }
+
+  // The commands are the lines starting with ' "'; the link is the last one.
+  llvm::StringRef linkLine;
+  llvm::SmallVector<llvm::StringRef, 8> lines;
+  (*plan)->getBuffer().split(lines, '\n');
+  for (llvm::StringRef line : lines) {
+    if (line.starts_with(" \"")) {
+      linkLine = line;
+    }
+  }
+
+  LinkPlan linkPlan;
+  linkPlan.args = splitDriverCommand(linkLine);
+  auto inputIt = std::find(linkPlan.args.begin(), linkPlan.args.end(),
+                           std::string(input.str()));
+  auto outputIt = std::find(linkPlan.args.begin(), linkPlan.args.end(), output);
+  if (inputIt == linkPlan.args.end() || outputIt == linkPlan.args.end()) {
+    return std::nullopt;
+  }
+  linkPlan.inputIndex = inputIt - linkPlan.args.begin();
+  linkPlan.outputIndex = outputIt - linkPlan.args.begin();
+  linkPlan.args[0] = "ld.lld";
+  return linkPlan;
+}
+
+/// The link plan of the clang at `clang` for `triple`, or nullptr if it
+/// cannot make one. Planned once per process, clang and triple; the compile
+/// server plans for the host before it forks, so its workers never run clang
+/// to link.
+const LinkPlan *getLinkPlan(const std::string &clang,
+                            const std::string &triple) {
+  static std::mutex mutex;
+  static std::map<std::pair<std::string, std::string>,
+                  std::optional<LinkPlan>>
+      plans;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto key = std::make_pair(clang, triple);
+  auto it = plans.find(key);
+  if (it == plans.end()) {
+    it = plans.emplace(key, planLink(clang, triple)).first;
+  }
+  return it->second ? &*it->second : nullptr;
+}
+
+/// Link with LLD inside this process, following clang's link plan: the
+/// program's objects and libraries take the placeholder's place.
+/// Returns nullopt, having linked nothing, if this is not possible here.
+std::optional<bool> linkWithLLD(const std::vector<std::string> &objectFiles,
+                                const std::string &outputFile,
+                                const CompilerOptions &opts) {
+  if (!llvm::Triple(opts.targetTriple).isOSBinFormatELF()) {
+    logVerbose(opts, "LLD: only ELF targets are linked in-process");
+    return std::nullopt;
+  }
+  auto clang = llvm::sys::findProgramByName("clang");
+  if (!clang) {
+    logVerbose(opts, "LLD: clang not found to plan the link");
+    return std::nullopt;
+  }
+  const LinkPlan *plan = getLinkPlan(*clang, opts.targetTriple);
+  if (!plan) {
+    logVerbose(opts, "LLD: clang -### did not give a link command");
+    return std::nullopt;
+  }
+
+  std::vector<std::string> linkArgs;
+  for (size_t i = 0; i < plan->args.size(); i++) {
+    if (i == plan->outputIndex) {
+      linkArgs.push_back(outputFile);
+    } else if (i == plan->inputIndex) {
+      linkArgs.insert(linkArgs.end(), objectFiles.begin(), objectFiles.end());
+      for (const auto &path : opts.libraryPaths) {
+        linkArgs.push_back("-L" + path);
+      }
+      for (const auto &lib : opts.libraries) {
+        linkArgs.push_back("-l" + lib);
+      }
+    } else {
+      linkArgs.push_back(plan->args[i]);
+    }
+  }
+
+  std::vector<const char *> argv;
+  for (const auto &arg : linkArgs) {
+    argv.push_back(arg.c_str());
+  }
+
+  auto linkStart = std::chrono::steady_clock::now();
+  lld::Result result = lld::lldMain(argv, llvm::outs(), llvm::errs(),
+                                    {{lld::Gnu, &lld::elf::link}});
+  logVerbose(opts, "Linked in-process with LLD in " + elapsedMillis(linkStart));
+  return result.retCode == 0;
+}
+#endif
+
 bool linkExecutable(const std::vector<std::string> &objectFiles,
                     const std::string &outputFile,
                     const CompilerOptions &opts) {
-  auto tryCommand = [](const std::string &cmd) -> bool {
-#ifdef _WIN32
-    int result = std::system((cmd + " >nul 2>nul").c_str());
+  llvm::TimeTraceScope timeScope("Link", outputFile);
+  if (opts.useLLD) {
+#ifdef RACCOON_HAVE_LLD
+    if (std::optional<bool> linked =
+            linkWithLLD(objectFiles, outputFile, opts)) {
+      if (!*linked) {
+        std::cerr << "Linking failed\n";
+        return false;
+      }
+      log(opts, "Linked executable written to " + outputFile);
+      return true;
+    }
+    logVerbose(opts, "Falling back to an external link");
 #else
-    int result = std::system((cmd + " >/dev/null 2>&1").c_str());
+    logVerbose(opts, "Built without LLD; falling back to an external link");
 #endif
-    return result == 0;
-  };
+  }
 
   std::string objects;
   for (const auto &obj : objectFiles) {
@@ -322,13 +919,13 @@ bool linkExecutable(const std::vector<std::string> &objectFiles,
   std::string linkCmd;
 
 #ifdef _WIN32
-  if (tryCommand("clang.exe --version")) {
+  if (hasClang()) {
     linkCmd = "clang.exe " + objects + libPaths + libs + "-o " + outputFile;
   } else {
     linkCmd = "link.exe /ENTRY:main /OUT:" + outputFile + " " + objects;
   }
 #else
-  if (tryCommand("clang --version")) {
+  if (hasClang()) {
     linkCmd = "clang " + objects + libPaths + libs + "-o " + outputFile;
   } else {
     linkCmd = "gcc " + objects + libPaths + libs + "-o " + outputFile;
@@ -346,93 +943,173 @@ bool linkExecutable(const std::vector<std::string> &objectFiles,
   return true;
 }
 
+/// Where C objects and cached IR are kept: .racobj next to the output file,
+/// so that every build directory has its own.
+fs::path getObjectDir(const CompilerOptions &opts) {
+  return fs::path(opts.outputFile).parent_path() / ".racobj";
+}
+
+/// The flags C sources are compiled with, besides the input and output.
+std::vector<std::string> getCFlags(const std::string &compiler,
+                                   const CompilerOptions &opts) {
+  std::vector<std::string> flags;
+  switch (opts.optimizeForDebug ? -1 : opts.optLevel) {
+  case -1:
+    flags.push_back("-Og");
+    break;
+  case 1:
+    flags.push_back("-O1");
+    break;
+  case 2:
+    flags.push_back("-O2");
+    break;
+  case 3:
+    flags.push_back("-O3");
+    break;
+  default:
+    flags.push_back("-O0");
+    break;
+  }
+  if (opts.generateDebugInfo) {
+    flags.push_back("-g");
+  }
+  if (opts.nativeCPU && compiler != "cl.exe") {
+    flags.push_back("-march=native");
+  }
+  return flags;
+}
+
+/// The object file for C source `cFile` compiled by `compiler` with `flags`:
+/// named after the source plus a hash of its absolute path and of the
+/// command, so shims with the same name in different directories do not
+/// overwrite each other, and objects built with other flags are not reused.
+std::string getCObjectPath(const std::string &cFile,
+                           const std::string &compiler,
+                           const std::vector<std::string> &flags,
+                           const CompilerOptions &opts) {
+  fs::path source(cFile);
+  std::string key = fs::absolute(source).lexically_normal().string() + "\n" +
+                    compiler + " " + llvm::join(flags, " ");
+  std::string name = source.stem().string() + "-" +
+                     llvm::utohexstr(BuildState::hash(key)) + ".o";
+  return (getObjectDir(opts) / name).string();
+}
+
+/// Compile one C source with the system compiler. The compiler's own output
+/// is captured into this thread's driver output, so that concurrent compiles
+/// are reported one after another.
+bool compileCSource(const std::string &cFile, const std::string &objFile,
+                    const std::string &compiler,
+                    const std::vector<std::string> &flags,
+                    const CompilerOptions &opts) {
+  // The object's name covers the flags, so only the source can be newer.
+  if (!opts.forceRecompile && fileExists(objFile)) {
+    long cTime = getFileModificationTime(cFile);
+    long objTime = getFileModificationTime(objFile);
+    if (cTime <= objTime) {
+      logVerbose(opts, "Skipping " + cFile + " (up to date)");
+      return true;
+    }
+  }
+
+  log(opts, "Compiling C source: " + cFile + "...");
+  llvm::TimeTraceScope timeScope("CompileC", cFile);
+
+  std::vector<std::string> args = {compiler, "-c"};
+  args.insert(args.end(), flags.begin(), flags.end());
+  args.insert(args.end(), {cFile, "-o", objFile});
+  logVerbose(opts, "C compile command: " + llvm::join(args, " "));
+
+  auto program = llvm::sys::findProgramByName(compiler);
+  llvm::SmallString<128> outputFile;
+  if (!program ||
+      llvm::sys::fs::createTemporaryFile("raccoon-cc", "txt", outputFile)) {
+    errStream() << "C compilation failed for " << cFile << " (cannot run "
+                << compiler << ")\n";
+    return false;
+  }
+
+  std::vector<llvm::StringRef> argRefs(args.begin(), args.end());
+  std::optional<llvm::StringRef> redirects[] = {
+      std::nullopt, llvm::StringRef(outputFile), llvm::StringRef(outputFile)};
+  int result =
+      llvm::sys::ExecuteAndWait(*program, argRefs, std::nullopt, redirects);
+  if (auto output = llvm::MemoryBuffer::getFile(outputFile)) {
+    errStream() << (*output)->getBuffer().str();
+  }
+  llvm::sys::fs::remove(outputFile);
+
+  if (result != 0) {
+    errStream() << "C compilation failed for " << cFile << " (exit code "
+                << result << ")\n";
+    return false;
+  }
+
+  log(opts, "C object file written to " + objFile);
+  return true;
+}
+
+/// Compile the C sources given on the command line, up to -j at a time.
 bool compileCSources(const std::vector<std::string> &cSourceFiles,
                      std::vector<std::string> &outputObjects,
+                     llvm::ThreadPoolInterface &pool,
                      const CompilerOptions &opts) {
   if (cSourceFiles.empty()) {
     return true;
   }
-
-  auto tryCommand = [](const std::string &cmd) -> bool {
-#ifdef _WIN32
-    int result = std::system((cmd + " >nul 2>nul").c_str());
-#else
-    int result = std::system((cmd + " >/dev/null 2>&1").c_str());
-#endif
-    return result == 0;
-  };
+  llvm::TimeTraceScope timeScope("CompileCSources");
 
   std::string compiler;
 #ifdef _WIN32
-  if (tryCommand("clang.exe --version")) {
+  if (hasClang()) {
     compiler = "clang.exe";
   } else {
     compiler = "cl.exe";
   }
 #else
-  if (tryCommand("clang --version")) {
+  if (hasClang()) {
     compiler = "clang";
   } else {
     compiler = "gcc";
   }
 #endif
 
-  for (const auto &cFile : cSourceFiles) {
-    fs::path cPath(cFile);
-    std::string objFile = cPath.stem().string() + ".o";
-
-    // Check if recompilation needed
-    if (!opts.forceRecompile && fileExists(objFile)) {
-      long cTime = getFileModificationTime(cFile);
-      long objTime = getFileModificationTime(objFile);
-      if (cTime <= objTime) {
-        logVerbose(opts, "Skipping " + cFile + " (up to date)");
-        outputObjects.push_back(objFile);
-        continue;
-      }
-    }
-
-    log(opts, "Compiling C source: " + cFile + "...");
-
-    std::string optFlag;
-    switch (opts.optLevel) {
-    case 0:
-      optFlag = "-O0";
-      break;
-    case 1:
-      optFlag = "-O1";
-      break;
-    case 2:
-      optFlag = "-O2";
-      break;
-    case 3:
-      optFlag = "-O3";
-      break;
-    default:
-      optFlag = "-O0";
-      break;
-    }
-
-    std::string compileCmd =
-        compiler + " -c " + optFlag + " " + cFile + " -o " + objFile;
-
-    if (opts.generateDebugInfo) {
-      compileCmd += " -g";
-    }
-
-    logVerbose(opts, "C compile command: " + compileCmd);
-    int result = std::system(compileCmd.c_str());
-    if (result != 0) {
-      std::cerr << "C compilation failed for " << cFile << " (exit code "
-                << result << ")\n";
-      return false;
-    }
+  fs::path objectDir = getObjectDir(opts);
+  std::error_code ec = llvm::sys::fs::create_directories(objectDir.string());
+  if (ec) {
+    std::cerr << "Error: Cannot create " << objectDir.string() << ": "
+              << ec.message() << "\n";
+    return false;
+  }
+  std::vector<std::string> flags = getCFlags(compiler, opts);
 
-    log(opts, "C object file written to " + objFile);
-    outputObjects.push_back(objFile);
+  struct CCompile {
+    std::string source;
+    std::string object;
+    bool ok = false;
+    UnitOutput output;
+  };
+  std::vector<CCompile> compiles(cSourceFiles.size());
+
+  for (size_t i = 0; i < cSourceFiles.size(); i++) {
+    CCompile &cc = compiles[i];
+    cc.source = cSourceFiles[i];
+    cc.object = getCObjectPath(cc.source, compiler, flags, opts);
+    pool.async([&cc, &compiler, &flags, &opts] {
+      TimeTraceThread timeTrace(opts);
+      OutputScope scope(cc.output);
+      cc.ok = compileCSource(cc.source, cc.object, compiler, flags, opts);
+    });
   }
+  pool.wait();
 
-  return true;
+  bool ok = true;
+  for (CCompile &cc : compiles) {
+    printOutput(cc.output);
+    ok &= cc.ok;
+    outputObjects.push_back(cc.object);
+  }
+  return ok;
 }
 
 struct CompilationUnit {
@@ -441,26 +1118,60 @@ struct CompilationUnit {
   std::string moduleName;
   std::vector<std::string> imports;
   std::vector<Statement *> program;
+  std::unique_ptr<llvm::MemoryBuffer> source; // tokens and names point here
+  std::unique_ptr<Arena> arena;               // owns every node in program
+  std::unique_ptr<TypeContext> types;         // uniques the program's types
+  bool parsed = false;
   bool compiled = false;
   bool isImported = false;
+
+  // Import graph, filled in by discoverUnits.
+  std::vector<CompilationUnit *> importUnits; // one per entry in imports
+  std::vector<CompilationUnit *> dependents;  // units that import this one
+  unsigned pendingImports = 0; // imports whose .racm is not written yet
+  bool finished = false;       // compileModule returned, output is final
+
+  // What the object file is built from now, and what it was built from last
+  // time (null if it never was).
+  UnitInputs inputs;
+  const UnitInputs *previousInputs = nullptr;
+
+  UnitOutput output;
 };
 
-bool compileModule(CompilationUnit &unit, const CompilerOptions &opts,
-                   std::map<std::string, CompilationUnit> &allUnits);
+/// Drop the unit's AST. All nodes live in the unit's arena, so this frees the
+/// whole tree at once instead of walking it. The source buffer goes with it
+/// since the nodes' names are views into it.
+void releaseProgram(CompilationUnit &unit) {
+  unit.program.clear();
+  unit.types.reset();
+  unit.arena.reset();
+  unit.source.reset();
+}
 
 bool loadAndParseSource(CompilationUnit &unit, const CompilerOptions &opts) {
-  std::ifstream file(unit.sourceFile);
-  if (!file) {
-    std::cerr << "Cannot open file: " << unit.sourceFile << '\n';
-    return false;
+  {
+    llvm::TimeTraceScope timeScope("ReadSource", unit.sourceFile);
+    // Large files are memory-mapped, small ones are read once into a buffer
+    // the unit owns. Either way the lexer works on it in place.
+    auto buffer = llvm::MemoryBuffer::getFile(unit.sourceFile);
+    if (!buffer) {
+      errStream() << "Cannot open file: " << unit.sourceFile << '\n';
+      return false;
+    }
+    unit.source = std::move(*buffer);
+    unit.inputs.source = BuildState::hash(std::string_view(
+        unit.source->getBufferStart(), unit.source->getBufferSize()));
   }
 
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  std::string source = buffer.str();
+  unit.arena = std::make_unique<Arena>();
+  unit.types = std::make_unique<TypeContext>(*unit.arena);
 
-  Lexer lexer(source);
-  Parser parser(lexer);
+  llvm::TimeTraceScope timeScope("Parse", unit.sourceFile);
+  auto parseStart = std::chrono::steady_clock::now();
+  Lexer lexer(std::string_view(unit.source->getBufferStart(),
+                               unit.source->getBufferSize()));
+  Parser parser(lexer, *unit.arena, *unit.types);
 
   std::vector<std::string> errors;
 
@@ -478,117 +1189,395 @@ bool loadAndParseSource(CompilationUnit &unit, const CompilerOptions &opts) {
   }
 
   if (!errors.empty()) {
-    std::cerr << "Compilation of '" << unit.sourceFile << "' failed with "
-              << errors.size() << " error(s):\n";
+    errStream() << "Compilation of '" << unit.sourceFile << "' failed with "
+                << errors.size() << " error(s):\n";
     for (const auto &err : errors) {
-      std::cerr << "  " << err << "\n";
+      errStream() << "  " << err << "\n";
     }
     return false;
   }
 
+  std::chrono::duration<double> parseTime =
+      std::chrono::steady_clock::now() - parseStart;
+  size_t tokensPerSec = lexer.tokenCount() / parseTime.count();
+  logStats(opts, unit.moduleName + ": parsed " +
+                     std::to_string(unit.source->getBufferSize()) +
+                     " bytes, " + std::to_string(lexer.tokenCount()) +
+                     " tokens in " + elapsedMillis(parseStart) + " (" +
+                     std::to_string(tokensPerSec) + " tokens/sec)");
+
   unit.imports = extractImports(unit.program);
+
+  logStats(opts, unit.moduleName + ": AST arena " +
+                     std::to_string(unit.arena->bytesUsed()) + " bytes used, " +
+                     std::to_string(unit.arena->bytesReserved()) +
+                     " bytes reserved in " +
+                     std::to_string(unit.arena->chunkCount()) + " chunk(s)");
   return true;
 }
 
-bool compileModule(CompilationUnit &unit, const CompilerOptions &opts,
-                   std::map<std::string, CompilationUnit> &allUnits) {
-  if (unit.compiled) {
-    return true;
-  }
-
+/// Parse a unit to find its imports. Every unit is parsed, even one that
+/// turns out to be up to date: whether it is depends on the interfaces of
+/// its imports, which are only final once those have been compiled.
+void scanUnit(CompilationUnit &unit, const CompilerOptions &opts) {
+  OutputScope scope(unit.output);
   logVerbose(opts, "Compiling module: " + unit.moduleName);
 
-  // Always parse the source to discover imports, even if we don't need to
-  // recompile
-  if (unit.program.empty()) {
-    if (!loadAndParseSource(unit, opts)) {
-      return false;
-    }
-  }
+  unit.parsed = loadAndParseSource(unit, opts);
+}
 
-  fs::path baseDir = fs::path(unit.sourceFile).parent_path();
-  if (baseDir.empty()) {
-    baseDir = ".";
+/// Parse every unit in allUnits and every module they import, transitively,
+/// and link up the import graph. Each round parses, in parallel, the modules
+/// first named by the previous round.
+bool discoverUnits(std::map<std::string, CompilationUnit> &allUnits,
+                   llvm::ThreadPoolInterface &pool,
+                   const CompilerOptions &opts) {
+  llvm::TimeTraceScope timeScope("DiscoverModules");
+  std::vector<CompilationUnit *> round;
+  for (auto &pair : allUnits) {
+    round.push_back(&pair.second);
   }
 
-  // Process dependencies first
-  for (const auto &import : unit.imports) {
-    fs::path importSourceFile = baseDir / (import + ".rac");
-    fs::path importObjFile = baseDir / (import + ".o");
+  bool ok = true;
+  while (!round.empty()) {
+    for (CompilationUnit *unit : round) {
+      pool.async([unit, &opts] {
+        TimeTraceThread timeTrace(opts);
+        scanUnit(*unit, opts);
+      });
+    }
+    pool.wait();
 
-    if (allUnits.find(import) != allUnits.end()) {
-      if (!compileModule(allUnits[import], opts, allUnits)) {
-        return false;
+    std::vector<CompilationUnit *> next;
+    for (CompilationUnit *unit : round) {
+      if (!unit->parsed) {
+        ok = false;
+        continue;
       }
-    } else {
-      // Check if we need to compile this dependency
-      // Even if metadata exists, we need the object file
-      if (fs::exists(importSourceFile)) {
-        logVerbose(opts, "Auto-compiling dependency: " + import);
-
-        CompilationUnit depUnit;
-        depUnit.sourceFile = importSourceFile.string();
-        depUnit.objectFile = importObjFile.string();
-        depUnit.moduleName = import;
-        depUnit.isImported = true;
-
-        allUnits[import] = depUnit;
-
-        if (!compileModule(allUnits[import], opts, allUnits)) {
-          std::cerr << "Error: Failed to compile dependency '" << import
-                    << "'\n";
-          return false;
+
+      OutputScope scope(unit->output);
+      fs::path baseDir = fs::path(unit->sourceFile).parent_path();
+      if (baseDir.empty()) {
+        baseDir = ".";
+      }
+
+      for (const auto &import : unit->imports) {
+        auto it = allUnits.find(import);
+        if (it == allUnits.end()) {
+          fs::path importSourceFile = baseDir / (import + ".rac");
+          if (!fs::exists(importSourceFile)) {
+            errStream() << "Error: Module '" << import << "' not found\n";
+            errStream() << "Required file '" << importSourceFile.string()
+                        << "' does not exist\n";
+            ok = false;
+            continue;
+          }
+
+          logVerbose(opts, "Auto-compiling dependency: " + import);
+
+          CompilationUnit depUnit;
+          depUnit.sourceFile = importSourceFile.string();
+          // Under --lto the unit's output is bitcode for the LTO link.
+          const char *extension = opts.lto != LTOMode::None ? ".bc" : ".o";
+          depUnit.objectFile = (baseDir / (import + extension)).string();
+          depUnit.moduleName = import;
+          depUnit.isImported = true;
+
+          it = allUnits.emplace(import, std::move(depUnit)).first;
+          next.push_back(&it->second);
         }
-      } else {
-        std::cerr << "Error: Module '" << import << "' not found\n";
-        std::cerr << "Required file '" << importSourceFile.string()
-                  << "' does not exist\n";
-        return false;
+
+        CompilationUnit *dep = &it->second;
+        unit->importUnits.push_back(dep);
+        dep->dependents.push_back(unit);
+        unit->pendingImports++;
       }
     }
+    round = std::move(next);
   }
+  return ok;
+}
+
+/// Order the units so that every module comes after the modules it imports,
+/// visiting them the way a serial depth-first build would. Reports the first
+/// import cycle found and returns false if there is one.
+bool orderUnits(std::map<std::string, CompilationUnit> &allUnits,
+                std::vector<CompilationUnit *> &order) {
+  enum class Visit : uint8_t { Active, Done };
+  std::map<const CompilationUnit *, Visit> visits;
+  std::vector<CompilationUnit *> path;
+
+  std::function<bool(CompilationUnit *)> visit = [&](CompilationUnit *unit) {
+    auto [it, inserted] = visits.try_emplace(unit, Visit::Active);
+    if (!inserted) {
+      if (it->second == Visit::Done) {
+        return true;
+      }
 
-  // Now check if we need to actually compile this module
-  if (!needsRecompilation(unit.sourceFile, unit.objectFile,
-                          opts.forceRecompile)) {
-    logVerbose(opts, "Skipping " + unit.sourceFile + " (up to date)");
-    unit.compiled = true;
+      std::string cycle;
+      auto start = std::find(path.begin(), path.end(), unit);
+      for (auto step = start; step != path.end(); ++step) {
+        cycle += (*step)->moduleName + " -> ";
+      }
+      cycle += unit->moduleName;
+      std::cerr << "Error: Import cycle: " << cycle << "\n";
+      return false;
+    }
+
+    path.push_back(unit);
+    for (CompilationUnit *dep : unit->importUnits) {
+      if (!visit(dep)) {
+        return false;
+      }
+    }
+    path.pop_back();
+
+    it->second = Visit::Done;
+    order.push_back(unit);
     return true;
+  };
+
+  for (auto &pair : allUnits) {
+    if (!visit(&pair.second)) {
+      return false;
+    }
   }
+  return true;
+}
 
-  log(opts, "Compiling " + unit.sourceFile + "...");
+/// Why the unit's object file must be rebuilt, or "" if it is up to date.
+/// Expects unit.inputs to be filled in.
+std::string getRebuildReason(const CompilationUnit &unit) {
+  const UnitInputs *previous = unit.previousInputs;
+  if (!previous || !fileExists(unit.objectFile)) {
+    return "not built before";
+  }
+  if (previous->frontend != unit.inputs.frontend ||
+      previous->config != unit.inputs.config) {
+    return "compiler or options changed";
+  }
+  if (previous->source != unit.inputs.source) {
+    return "source changed";
+  }
+  if (previous->imports != unit.inputs.imports) {
+    return "an imported interface changed";
+  }
+  if (hasExports(unit.program) &&
+      !fileExists(getMetadataPath(unit.sourceFile))) {
+    return "interface file missing";
+  }
+  return "";
+}
+
+void printUnitOutput(CompilationUnit &unit) { printOutput(unit.output); }
+
+/// Where the unit's unoptimized IR is cached. The name carries a hash of
+/// everything the IR was generated from, including the compiler build (see
+/// getCompilerFingerprint), so a stale file is never picked up.
+std::string getBitcodeCachePath(const CompilationUnit &unit,
+                                const CompilerOptions &opts) {
+  std::ostringstream key;
+  key << std::hex << unit.inputs.frontend << " " << unit.inputs.source;
+  for (const auto &[module, interface] : unit.inputs.imports) {
+    key << " " << module << " " << interface;
+  }
+
+  std::ostringstream name;
+  name << unit.moduleName << "-" << std::hex << std::setw(16)
+       << std::setfill('0') << BuildState::hash(key.str()) << ".bc";
+  return (getObjectDir(opts) / name.str()).string();
+}
+
+/// Cache the unit's verified, unoptimized IR, replacing the one cached for
+/// earlier versions of it. Failing to write the cache is not an error.
+void writeBitcodeCache(const CompilationUnit &unit, const llvm::Module &module,
+                       const CompilerOptions &opts) {
+  fs::path path = getBitcodeCachePath(unit, opts);
+  fs::path objectDir = getObjectDir(opts);
+  std::error_code ec = llvm::sys::fs::create_directories(objectDir.string());
+  if (!ec) {
+    llvm::raw_fd_ostream out(path.string(), ec, llvm::sys::fs::OF_None);
+    if (!ec) {
+      llvm::WriteBitcodeToFile(module, out);
+    }
+  }
+  if (ec) {
+    logVerbose(opts, "Cannot cache IR in " + path.string() + ": " +
+                         ec.message());
+    return;
+  }
+
+  // Entries of this module are <module>-<16 hex digits>.bc.
+  std::string prefix = unit.moduleName + "-";
+  size_t nameSize = prefix.size() + 16 + 3;
+  for (const auto &entry : fs::directory_iterator(objectDir, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() == nameSize && name.rfind(prefix, 0) == 0 &&
+        name.compare(nameSize - 3, 3, ".bc") == 0 &&
+        std::all_of(name.begin() + prefix.size(), name.end() - 3,
+                    llvm::isHexDigit) &&
+        entry.path() != path) {
+      fs::remove(entry.path(), ec);
+    }
+  }
+}
+
+/// The unit's cached IR, if only code generation options changed since it
+/// was built: the source, its imports and the front end, down to the
+/// compiler build, are all the same, so the IR would come out identical.
+/// Returns nullptr otherwise.
+std::unique_ptr<llvm::Module> loadBitcodeCache(const CompilationUnit &unit,
+                                               llvm::LLVMContext &context,
+                                               const CompilerOptions &opts) {
+  const UnitInputs *previous = unit.previousInputs;
+  if (opts.forceRecompile || !previous ||
+      previous->frontend != unit.inputs.frontend ||
+      previous->source != unit.inputs.source ||
+      previous->imports != unit.inputs.imports ||
+      (hasExports(unit.program) &&
+       !fileExists(getMetadataPath(unit.sourceFile)))) {
+    return nullptr;
+  }
+
+  std::string path = getBitcodeCachePath(unit, opts);
+  llvm::TimeTraceScope timeScope("LoadCachedIR", path);
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    return nullptr;
+  }
+  auto module = llvm::parseBitcodeFile(**buffer, context);
+  if (!module) {
+    logVerbose(opts, "Ignoring cached IR in " + path + ": " +
+                         llvm::toString(module.takeError()));
+    return nullptr;
+  }
+  logVerbose(opts, "Reusing cached IR from " + path);
+  return std::move(*module);
+}
 
-  Codegen codegen(unit.moduleName);
+/// Run the front end on a parsed unit: generate and verify its IR, write its
+/// .racm and call `interfaceReady`. The module lives in `codegen`'s context.
+/// Returns nullptr after reporting an error.
+std::unique_ptr<llvm::Module>
+generateModule(CompilationUnit &unit, Codegen &codegen,
+               const CompilerOptions &opts,
+               const std::function<void()> &interfaceReady) {
+  llvm::TimeTraceScope timeScope("Frontend", unit.sourceFile);
   codegen.setModuleName(unit.moduleName);
 
+  auto importStart = std::chrono::steady_clock::now();
+  fs::path importBaseDir = fs::path(unit.sourceFile).parent_path();
+  if (importBaseDir.empty()) {
+    importBaseDir = ".";
+  }
   for (const auto &import : unit.imports) {
-    fs::path importBaseDir = fs::path(unit.sourceFile).parent_path();
-    if (importBaseDir.empty()) {
-      importBaseDir = ".";
-    }
     codegen.loadImport(import, importBaseDir.string());
   }
+  logStats(opts, unit.moduleName + ": imports " + elapsedMillis(importStart));
 
+  auto codegenStart = std::chrono::steady_clock::now();
   codegen.generate(unit.program);
+  logStats(opts, unit.moduleName + ": codegen " + elapsedMillis(codegenStart));
   auto llvmModule = codegen.takeModule();
 
   std::string verifyError;
   llvm::raw_string_ostream verifyStream(verifyError);
-  if (llvm::verifyModule(*llvmModule, &verifyStream)) {
-    llvm::errs() << "Module verification failed for " << unit.sourceFile
-                 << ":\n"
-                 << verifyError << "\n";
-    return false;
+  bool broken;
+  {
+    llvm::TimeTraceScope verifyScope("VerifyModule", unit.moduleName);
+    broken = llvm::verifyModule(*llvmModule, &verifyStream);
+  }
+  if (broken) {
+    errStream() << "Module verification failed for " << unit.sourceFile
+                << ":\n"
+                << verifyStream.str() << "\n";
+    return nullptr;
   }
 
   if (hasExports(unit.program)) {
     ModuleMetadata metadata = codegen.getExportedSymbols();
     std::string metadataPath = getMetadataPath(unit.sourceFile);
-    metadata.saveToFile(metadataPath);
-    logVerbose(opts, "Module metadata written to " + metadataPath);
+    unit.inputs.interface = metadata.fingerprint();
+
+    // Early cutoff: if only bodies changed, the .racm stays as it was, so
+    // importers (and anything else watching the file) see no change.
+    const UnitInputs *previous = unit.previousInputs;
+    if (!opts.forceRecompile && previous &&
+        previous->interface == unit.inputs.interface &&
+        fileExists(metadataPath)) {
+      logVerbose(opts, "Module metadata unchanged in " + metadataPath);
+    } else {
+      if (!metadata.saveToFile(metadataPath)) {
+        return nullptr;
+      }
+      logVerbose(opts, "Module metadata written to " + metadataPath);
+    }
+    if (opts.emitRacmText) {
+      metadata.saveTextToFile(metadataPath + ".txt");
+      logVerbose(opts, "Module metadata dump written to " + metadataPath +
+                           ".txt");
+    }
+  }
+  interfaceReady();
+
+  // Codegen is done with the AST; nothing below needs it.
+  releaseProgram(unit);
+
+  writeBitcodeCache(unit, *llvmModule, opts);
+  return llvmModule;
+}
+
+/// Generate code for one parsed unit. `interfaceReady` is called as soon as
+/// the unit's .racm is on disk and its fingerprint is in unit.inputs, before
+/// the object file is emitted, so that modules importing it can start.
+bool compileModule(CompilationUnit &unit, const CompilerOptions &opts,
+                   const std::function<void()> &interfaceReady) {
+  // The interfaces of every import are final by now, so this is the first
+  // point at which we can tell whether the unit is up to date.
+  for (size_t i = 0; i < unit.imports.size(); i++) {
+    unit.inputs.imports.emplace_back(unit.imports[i],
+                                     unit.importUnits[i]->inputs.interface);
+  }
+
+  if (!opts.forceRecompile) {
+    std::string reason = getRebuildReason(unit);
+    if (reason.empty()) {
+      logVerbose(opts, "Skipping " + unit.sourceFile + " (up to date)");
+      unit.inputs.interface = unit.previousInputs->interface;
+      releaseProgram(unit);
+      interfaceReady();
+      unit.compiled = true;
+      return true;
+    }
+    logVerbose(opts, "Rebuilding " + unit.sourceFile + " (" + reason + ")");
+  }
+
+  log(opts, "Compiling " + unit.sourceFile + "...");
+  llvm::TimeTraceScope timeScope("CompileModule", unit.sourceFile);
+
+  // A module read from the cache lives in `cachedContext`; a generated one
+  // in the Codegen's own context.
+  llvm::LLVMContext cachedContext;
+  std::unique_ptr<Codegen> codegen;
+  std::unique_ptr<llvm::Module> llvmModule =
+      loadBitcodeCache(unit, cachedContext, opts);
+  if (llvmModule) {
+    // Same source and imports as last time, so the same interface too.
+    unit.inputs.interface = unit.previousInputs->interface;
+    interfaceReady();
+    releaseProgram(unit);
+  } else {
+    codegen = std::make_unique<Codegen>(unit.moduleName, *unit.types);
+    llvmModule = generateModule(unit, *codegen, opts, interfaceReady);
+    if (!llvmModule) {
+      return false;
+    }
   }
 
-  if (!emitObjectFile(llvmModule.get(), unit.objectFile, opts)) {
+  bool emitted = opts.lto != LTOMode::None
+                     ? emitBitcodeFile(llvmModule.get(), unit.objectFile, opts)
+                     : emitObjectFile(llvmModule.get(), unit.objectFile, opts);
+  if (!emitted) {
     return false;
   }
 
@@ -596,6 +1585,306 @@ bool compileModule(CompilationUnit &unit, const CompilerOptions &opts,
   return true;
 }
 
+/// Compile the units in `order` on the pool. A unit is started once every
+/// module it imports has written its .racm; buffered output is printed in
+/// `order` as units finish. After the first failure no new units are started.
+bool compileUnits(const std::vector<CompilationUnit *> &order,
+                  llvm::ThreadPoolInterface &pool,
+                  const CompilerOptions &opts) {
+  llvm::TimeTraceScope timeScope("CompileModules");
+  std::mutex mutex; // guards pendingImports, finished, failed and printed
+  bool failed = false;
+  size_t printed = 0;
+
+  std::function<void(CompilationUnit *)> start = [&](CompilationUnit *unit) {
+    pool.async([&, unit] {
+      TimeTraceThread timeTrace(opts);
+      auto interfaceReady = [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed) {
+          return;
+        }
+        for (CompilationUnit *dependent : unit->dependents) {
+          if (--dependent->pendingImports == 0) {
+            start(dependent);
+          }
+        }
+      };
+
+      bool ok;
+      {
+        OutputScope scope(unit->output);
+        ok = compileModule(*unit, opts, interfaceReady);
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      unit->finished = true;
+      failed |= !ok;
+      while (printed < order.size() && order[printed]->finished) {
+        printUnitOutput(*order[printed++]);
+      }
+    });
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (CompilationUnit *unit : order) {
+      if (unit->pendingImports == 0) {
+        start(unit);
+      }
+    }
+  }
+  pool.wait();
+
+  // A failure leaves units that never ran; print whatever did.
+  for (; printed < order.size(); printed++) {
+    if (order[printed]->finished) {
+      printUnitOutput(*order[printed]);
+    }
+  }
+  return !failed;
+}
+
+/// Symbols that the given object files use but do not define. Under LTO these
+/// stay external, since code outside the merged module calls them. Files that
+/// are not object files (archives, linker scripts) are skipped.
+std::set<std::string>
+getUndefinedSymbols(const std::vector<std::string> &objectFiles,
+                    const CompilerOptions &opts) {
+  bool machO = llvm::Triple(opts.targetTriple).isOSBinFormatMachO();
+  std::set<std::string> symbols;
+  for (const auto &path : objectFiles) {
+    auto object = llvm::object::ObjectFile::createObjectFile(path);
+    if (!object) {
+      llvm::consumeError(object.takeError());
+      logVerbose(opts, "Not scanning " + path + " for symbols");
+      continue;
+    }
+    for (const llvm::object::SymbolRef &symbol :
+         object->getBinary()->symbols()) {
+      auto flags = symbol.getFlags();
+      if (!flags) {
+        llvm::consumeError(flags.takeError());
+        continue;
+      }
+      if (!(*flags & llvm::object::SymbolRef::SF_Undefined)) {
+        continue;
+      }
+      auto name = symbol.getName();
+      if (!name) {
+        llvm::consumeError(name.takeError());
+        continue;
+      }
+      // Mach-O prefixes C names with an underscore; IR names have none.
+      llvm::StringRef irName = *name;
+      if (machO) {
+        irName.consume_front("_");
+      }
+      symbols.insert(irName.str());
+    }
+  }
+  return symbols;
+}
+
+/// --lto=full: merge the bitcode of every unit into one module, internalize
+/// everything except `main` and the symbols in `preserved`, optimize the
+/// whole program and emit it as a single object file.
+///
+/// With --emit-object nothing is internalized, because whatever links the
+/// object may call any of its functions.
+bool linkFullLTO(const std::vector<CompilationUnit *> &order,
+                 const std::set<std::string> &preserved,
+                 const std::string &filename, const CompilerOptions &opts) {
+  log(opts, "Linking " + std::to_string(order.size()) +
+                " modules for link-time optimization...");
+  llvm::TimeTraceScope timeScope("LTO", filename);
+
+  auto linkStart = std::chrono::steady_clock::now();
+  llvm::LLVMContext context;
+  auto program = std::make_unique<llvm::Module>("raccoon-lto", context);
+  llvm::Linker linker(*program);
+  for (CompilationUnit *unit : order) {
+    auto buffer = llvm::MemoryBuffer::getFile(unit->objectFile);
+    if (!buffer) {
+      errStream() << "Error: Cannot read bitcode file: " << unit->objectFile
+                  << "\n";
+      return false;
+    }
+    auto module = llvm::parseBitcodeFile(**buffer, context);
+    if (!module) {
+      errStream() << "Error: Invalid bitcode file " << unit->objectFile << ": "
+                  << llvm::toString(module.takeError()) << "\n";
+      return false;
+    }
+    if (linker.linkInModule(std::move(*module))) {
+      errStream() << "Error: Cannot link " << unit->objectFile << "\n";
+      return false;
+    }
+  }
+
+  if (!opts.noLink) {
+    llvm::internalizeModule(*program, [&](const llvm::GlobalValue &value) {
+      return value.getName() == "main" ||
+             preserved.count(value.getName().str());
+    });
+  }
+  logStats(opts, "lto: link " + elapsedMillis(linkStart));
+
+  llvm::TargetMachine *targetMachine = prepareModule(program.get(), opts);
+  if (!targetMachine) {
+    return false;
+  }
+
+  auto emitStart = std::chrono::steady_clock::now();
+  optimizeModule(program.get(), targetMachine, Pipeline::FullPostLink, opts);
+  if (!writeObjectFile(program.get(), targetMachine, filename)) {
+    return false;
+  }
+
+  logVerbose(opts, "Optimized and emitted in " + elapsedMillis(emitStart));
+  log(opts, "Object file written to " + filename);
+  return true;
+}
+
+/// --lto=thin: hand the bitcode of every unit to LLVM's ThinLTO driver, which
+/// combines their summaries, decides what each module imports from the others
+/// and runs one backend per module on up to -j threads. As with full LTO,
+/// only `main` and the symbols in `preserved` stay visible outside.
+///
+/// With --thinlto-cache-dir, backend results are cached under a key covering
+/// the module, everything it imports and the options, so a rebuild only runs
+/// the backends whose inputs changed. The objects are appended to
+/// `objectFiles`.
+bool linkThinLTO(const std::vector<CompilationUnit *> &order,
+                 const std::set<std::string> &preserved,
+                 std::vector<std::string> &objectFiles,
+                 const CompilerOptions &opts) {
+  log(opts, "Linking " + std::to_string(order.size()) +
+                " modules for link-time optimization...");
+  llvm::TimeTraceScope timeScope("ThinLTO");
+
+  llvm::lto::Config config;
+  config.CPU = opts.cpu;
+  llvm::SmallVector<llvm::StringRef, 16> features;
+  llvm::StringRef(opts.features).split(features, ',', -1, false);
+  for (llvm::StringRef feature : features) {
+    config.MAttrs.push_back(feature.str());
+  }
+  config.RelocModel = getRelocModel(opts);
+  config.CGOptLevel = getCodeGenOptLevel(opts);
+  config.OptLevel = opts.optLevel;
+  // The backends' threads profile themselves when asked to.
+  config.TimeTraceEnabled = llvm::timeTraceProfilerEnabled();
+  config.TimeTraceGranularity = opts.timeTraceGranularity;
+
+  llvm::lto::ThinBackend backend = llvm::lto::createInProcessThinBackend(
+      llvm::hardware_concurrency(opts.jobs));
+  llvm::lto::LTO lto(std::move(config), backend);
+
+  auto fail = [](llvm::Error error) {
+    errStream() << "Error: " << llvm::toString(std::move(error)) << "\n";
+    return false;
+  };
+
+  // The inputs point into these buffers until the backends are done.
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> bitcode;
+  std::map<std::string, std::string> definedIn;
+  for (CompilationUnit *unit : order) {
+    auto buffer = llvm::MemoryBuffer::getFile(unit->objectFile);
+    if (!buffer) {
+      errStream() << "Error: Cannot read bitcode file: " << unit->objectFile
+                  << "\n";
+      return false;
+    }
+    bitcode.push_back(std::move(*buffer));
+
+    auto input = llvm::lto::InputFile::create(*bitcode.back());
+    if (!input) {
+      return fail(input.takeError());
+    }
+
+    std::vector<llvm::lto::SymbolResolution> resolutions;
+    for (const llvm::lto::InputFile::Symbol &symbol : (*input)->symbols()) {
+      std::string name = symbol.getIRName().str();
+      llvm::lto::SymbolResolution resolution;
+      if (!symbol.isUndefined()) {
+        auto [it, inserted] = definedIn.emplace(name, unit->sourceFile);
+        if (!inserted) {
+          errStream() << "Error: '" << name << "' is defined in both "
+                      << it->second << " and " << unit->sourceFile << "\n";
+          return false;
+        }
+        resolution.Prevailing = true;
+      }
+      resolution.VisibleToRegularObj =
+          opts.noLink || name == "main" || preserved.count(name);
+      resolutions.push_back(resolution);
+    }
+
+    if (llvm::Error error = lto.add(std::move(*input), resolutions)) {
+      return fail(std::move(error));
+    }
+  }
+
+  // Backends write into `buffers`; cached results arrive in `cached`.
+  size_t taskCount = lto.getMaxTasks();
+  std::vector<llvm::SmallString<0>> buffers(taskCount);
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> cached(taskCount);
+
+  llvm::FileCache cache;
+  if (!opts.thinLTOCacheDir.empty()) {
+    auto localCache = llvm::localCache(
+        "ThinLTO", "Thin", opts.thinLTOCacheDir,
+        [&](size_t task, const llvm::Twine &,
+            std::unique_ptr<llvm::MemoryBuffer> buffer) {
+          cached[task] = std::move(buffer);
+        });
+    if (!localCache) {
+      return fail(localCache.takeError());
+    }
+    cache = std::move(*localCache);
+  }
+
+  auto backendStart = std::chrono::steady_clock::now();
+  auto addStream = [&](size_t task, const llvm::Twine &)
+      -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+    return std::make_unique<llvm::CachedFileStream>(
+        std::make_unique<llvm::raw_svector_ostream>(buffers[task]));
+  };
+  if (llvm::Error error = lto.run(addStream, cache)) {
+    return fail(std::move(error));
+  }
+  logStats(opts, "lto: backends " + elapsedMillis(backendStart));
+
+  if (!opts.thinLTOCacheDir.empty()) {
+    llvm::pruneCache(opts.thinLTOCacheDir, llvm::CachePruningPolicy());
+  }
+
+  // One object per backend that produced code, named after the output.
+  fs::path stem = fs::path(getObjectFileName(opts.outputFile));
+  stem.replace_extension();
+  for (size_t task = 0; task < taskCount; task++) {
+    llvm::StringRef data =
+        cached[task] ? cached[task]->getBuffer() : buffers[task].str();
+    if (data.empty()) {
+      continue;
+    }
+
+    std::string filename =
+        getObjectFileName(stem.string() + "-lto" + std::to_string(task));
+    std::error_code ec;
+    llvm::raw_fd_ostream dest(filename, ec, llvm::sys::fs::OF_None);
+    if (ec) {
+      errStream() << "Error: Could not open file: " << ec.message() << "\n";
+      return false;
+    }
+    dest << data;
+    objectFiles.push_back(filename);
+    logVerbose(opts, "Object file written to " + filename);
+  }
+  return true;
+}
+
 void printUsage(const char *progName) {
   std::cerr
       << "Usage: " << progName << " <source_file> [options]\n"
@@ -608,11 +1897,27 @@ void printUsage(const char *progName) {
       << "  <file.o>          Add pre-compiled object file to link\n"
       << "  -l <library>      Link with library (e.g., -lm for math)\n"
       << "  -L <path>         Add library search path\n"
+      << "  --lld             Link in-process with LLD when available\n"
+      << "  --lto=<mode>      Link-time optimization: none (default), full "
+         "or thin\n"
+      << "  --thinlto-cache-dir <dir>  Reuse ThinLTO backend results from "
+         "<dir>\n"
       << "  -O0, -O1, -O2, -O3  Set optimization level (default: -O0)\n"
+      << "  -Og               Cheap optimizations for fast debug builds\n"
       << "  -g                Generate debug information (not implemented)\n"
       << "  -v, --verbose     Enable verbose output\n"
       << "  -q, --quiet       Suppress non-error output\n"
+      << "  --stats           Print per-module compiler statistics\n"
+      << "  --time-trace=<file>  Write a Chrome trace of the build to <file>\n"
+      << "  --time-trace-granularity=<us>  Leave out spans shorter than this "
+         "(default: 500)\n"
+      << "  --emit-racm-text  Also dump module metadata as text (.racm.txt)\n"
       << "  -f, --force       Force recompilation of all files\n"
+      << "  -j <N>            Compile up to N modules at once (default: 1)\n"
+      << "  --cpu <name>      Generate code for this CPU (default: generic)\n"
+      << "  --features <list> Enable (+) or disable (-) CPU features, e.g. "
+         "+avx2,+fma\n"
+      << "  -march=native     Use the host's CPU and features\n"
       << "  --target <triple>  Specify target architecture/platform\n"
       << "                     Affects codegen, relocation model, and "
          "linking.\n"
@@ -624,9 +1929,36 @@ void printUsage(const char *progName) {
          "(bootable)\n"
       << "                       x86_64-uefi        - UEFI PE32+ application\n"
       << "                     Default: host triple (e.g. x86_64-linux-gnu)\n"
+      << "  --server [socket] Serve compiles for raccoonc-client (Unix only)\n"
       << "  --help            Display this help message\n";
 }
 
+/// For -march=native: take the CPU and features of the machine we run on.
+/// Features from --features are applied after the host's, so they win.
+bool resolveNativeCPU(CompilerOptions &opts) {
+  llvm::Triple host(llvm::sys::getProcessTriple());
+  if (llvm::Triple(opts.targetTriple).getArch() != host.getArch()) {
+    std::cerr << "Error: -march=native needs a target of the host's "
+              << "architecture (" << host.getArchName().str() << ")\n";
+    return false;
+  }
+
+  llvm::StringMap<bool> hostFeatures = llvm::sys::getHostCPUFeatures();
+  std::vector<std::string> features;
+  for (const auto &feature : hostFeatures) {
+    features.push_back((feature.getValue() ? "+" : "-") +
+                       feature.getKey().str());
+  }
+  std::sort(features.begin(), features.end());
+  if (!opts.features.empty()) {
+    features.push_back(opts.features);
+  }
+
+  opts.cpu = llvm::sys::getHostCPUName().str();
+  opts.features = llvm::join(features, ",");
+  return true;
+}
+
 bool parseArguments(int argc, const char *argv[], CompilerOptions &opts) {
   if (argc < 2) {
     printUsage(argv[0]);
@@ -654,12 +1986,20 @@ bool parseArguments(int argc, const char *argv[], CompilerOptions &opts) {
       opts.libraryPaths.push_back(argv[++i]);
     } else if (arg == "-O0") {
       opts.optLevel = 0;
+      opts.optimizeForDebug = false;
     } else if (arg == "-O1") {
       opts.optLevel = 1;
+      opts.optimizeForDebug = false;
     } else if (arg == "-O2") {
       opts.optLevel = 2;
+      opts.optimizeForDebug = false;
     } else if (arg == "-O3") {
       opts.optLevel = 3;
+      opts.optimizeForDebug = false;
+    } else if (arg == "-Og") {
+      // CodeGenOptLevel::Less, like -O1, but a much shorter IR pipeline.
+      opts.optLevel = 1;
+      opts.optimizeForDebug = true;
     } else if (arg == "-g") {
       opts.generateDebugInfo = true;
     } else if (arg == "-v" || arg == "--verbose") {
@@ -668,6 +2008,48 @@ bool parseArguments(int argc, const char *argv[], CompilerOptions &opts) {
       opts.quiet = true;
     } else if (arg == "-f" || arg == "--force") {
       opts.forceRecompile = true;
+    } else if (arg == "--stats") {
+      opts.printStats = true;
+    } else if (arg == "--emit-racm-text") {
+      opts.emitRacmText = true;
+    } else if (arg == "--lld") {
+      opts.useLLD = true;
+    } else if (arg.rfind("--lto=", 0) == 0) {
+      std::string mode = arg.substr(6);
+      if (mode == "none") {
+        opts.lto = LTOMode::None;
+      } else if (mode == "full") {
+        opts.lto = LTOMode::Full;
+      } else if (mode == "thin") {
+        opts.lto = LTOMode::Thin;
+      } else {
+        std::cerr << "Unknown LTO mode: " << mode << "\n";
+        return false;
+      }
+    } else if (arg == "--thinlto-cache-dir" && i + 1 < argc) {
+      opts.thinLTOCacheDir = argv[++i];
+    } else if (arg.rfind("--thinlto-cache-dir=", 0) == 0) {
+      opts.thinLTOCacheDir = arg.substr(20);
+    } else if (arg.rfind("--time-trace=", 0) == 0 && arg.size() > 13) {
+      opts.timeTraceFile = arg.substr(13);
+    } else if (arg.rfind("--time-trace-granularity=", 0) == 0) {
+      std::string value = arg.substr(25);
+      char *end = nullptr;
+      unsigned long granularity = std::strtoul(value.c_str(), &end, 10);
+      if (value.empty() || *end != '\0') {
+        std::cerr << "Invalid time trace granularity: " << value << "\n";
+        return false;
+      }
+      opts.timeTraceGranularity = granularity;
+    } else if (arg.rfind("-j", 0) == 0 && (arg.size() > 2 || i + 1 < argc)) {
+      std::string count = arg.size() > 2 ? arg.substr(2) : argv[++i];
+      char *end = nullptr;
+      unsigned long jobs = std::strtoul(count.c_str(), &end, 10);
+      if (count.empty() || *end != '\0' || jobs == 0) {
+        std::cerr << "Invalid job count: " << count << "\n";
+        return false;
+      }
+      opts.jobs = jobs;
     } else if (arg[0] != '-') {
       fs::path p(arg);
       std::string ext = p.extension().string();
@@ -682,6 +2064,18 @@ bool parseArguments(int argc, const char *argv[], CompilerOptions &opts) {
         // Assume .rac if no extension
         opts.sourceFiles.push_back(arg);
       }
+    } else if (arg == "--cpu" && i + 1 < argc) {
+      opts.cpu = argv[++i];
+    } else if (arg.rfind("--cpu=", 0) == 0) {
+      opts.cpu = arg.substr(6);
+    } else if (arg == "--features" && i + 1 < argc) {
+      opts.features = argv[++i];
+    } else if (arg.rfind("--features=", 0) == 0) {
+      opts.features = arg.substr(11);
+    } else if (arg == "-march=native") {
+      opts.nativeCPU = true;
+    } else if (arg.rfind("-march=", 0) == 0) {
+      opts.cpu = arg.substr(7);
     } else if (arg == "--target" && i + 1 < argc) {
       opts.targetTriple = argv[++i];
       if (opts.targetTriple == "x86_64-bios") {
@@ -700,6 +2094,10 @@ bool parseArguments(int argc, const char *argv[], CompilerOptions &opts) {
     return false;
   }
 
+  if (opts.nativeCPU && !resolveNativeCPU(opts)) {
+    return false;
+  }
+
   if (opts.bareMetal) {
     log(opts, "[INFO] BIOS target detected; skipping host linker.");
     log(opts, "       Use ld -T linker.ld -nostdlib -o kernel.elf ...");
@@ -709,12 +2107,14 @@ bool parseArguments(int argc, const char *argv[], CompilerOptions &opts) {
   return true;
 }
 
-int main(int argc, const char *argv[]) {
+int runCompiler(int argc, const char *argv[]) {
   CompilerOptions opts;
 
   if (!parseArguments(argc, argv, opts)) {
     return 1;
   }
+  // Declared first so that it outlives every thread pool and span below.
+  TimeTraceSession timeTrace(opts);
 
   std::map<std::string, CompilationUnit> allUnits;
   std::vector<std::string> objectFiles;
@@ -739,14 +2139,19 @@ int main(int argc, const char *argv[]) {
       baseDir = ".";
     }
 
-    Codegen codegen(unit.moduleName);
+    Codegen codegen(unit.moduleName, *unit.types);
     codegen.setModuleName(unit.moduleName);
 
+    auto importStart = std::chrono::steady_clock::now();
     for (const auto &import : unit.imports) {
       codegen.loadImport(import, baseDir.string());
     }
+    logStats(opts, unit.moduleName + ": imports " + elapsedMillis(importStart));
 
+    auto codegenStart = std::chrono::steady_clock::now();
     codegen.generate(unit.program);
+    logStats(opts,
+             unit.moduleName + ": codegen " + elapsedMillis(codegenStart));
     auto llvmModule = codegen.takeModule();
 
     std::string verifyError;
@@ -766,10 +2171,6 @@ int main(int argc, const char *argv[]) {
     dest.flush();
     log(opts, "LLVM IR written to: " + opts.outputFile);
 
-    for (auto stmt : unit.program) {
-      delete stmt;
-    }
-
     return 0;
   }
 
@@ -783,42 +2184,91 @@ int main(int argc, const char *argv[]) {
     unit.sourceFile = sourceFile;
     unit.moduleName = getBaseName(sourceFile);
 
-    if (opts.sourceFiles.size() == 1 && !opts.noLink) {
+    if (opts.lto != LTOMode::None) {
+      unit.objectFile = unit.moduleName + ".bc";
+    } else if (opts.sourceFiles.size() == 1 && !opts.noLink) {
       unit.objectFile = getObjectFileName(opts.outputFile);
     } else {
       unit.objectFile = unit.moduleName + ".o";
     }
 
-    allUnits[unit.moduleName] = unit;
+    allUnits[unit.moduleName] = std::move(unit);
   }
 
-  for (auto &pair : allUnits) {
-    if (!compileModule(pair.second, opts, allUnits)) {
+  llvm::DefaultThreadPool pool(llvm::hardware_concurrency(opts.jobs));
 
-      for (auto &unitPair : allUnits) {
-        for (auto stmt : unitPair.second.program) {
-          delete stmt;
-        }
-      }
-      return 1;
+  bool discovered = discoverUnits(allUnits, pool, opts);
+  std::vector<CompilationUnit *> order;
+  if (!discovered || !orderUnits(allUnits, order)) {
+    for (auto &pair : allUnits) {
+      printUnitOutput(pair.second);
     }
+    return 1;
+  }
+
+  BuildState buildState;
+  buildState.load(BuildStateFile);
+  uint64_t frontend = hashFrontendConfiguration(opts);
+  uint64_t config = hashConfiguration(opts);
+  for (CompilationUnit *unit : order) {
+    unit->inputs.frontend = frontend;
+    unit->inputs.config = config;
+    unit->previousInputs = buildState.find(unit->objectFile);
+  }
+
+  // Register the target up front rather than in whichever module gets there
+  // first, so that -v reports it once and in the same place every time.
+  auto targetStart = std::chrono::steady_clock::now();
+  std::string targetError;
+  if (!findTarget(llvm::Triple(opts.targetTriple), targetError)) {
+    std::cerr << "Error: " << targetError << "\n";
+    return 1;
   }
+  logVerbose(opts, "Registered target " + opts.targetTriple + " in " +
+                       elapsedMillis(targetStart));
 
-  // Collect ALL object files from all compiled units (including dependencies)
-  for (const auto &pair : allUnits) {
-    if (pair.second.compiled && fileExists(pair.second.objectFile)) {
-      objectFiles.push_back(pair.second.objectFile);
+  bool compiled = compileUnits(order, pool, opts);
+
+  // Record every unit that made it, even if another one failed.
+  for (CompilationUnit *unit : order) {
+    if (unit->compiled) {
+      buildState.record(unit->objectFile, std::move(unit->inputs));
     }
   }
+  if (!buildState.save(BuildStateFile) || !compiled) {
+    return 1;
+  }
 
   std::vector<std::string> cObjectFiles;
-  if (!compileCSources(opts.cSourceFiles, cObjectFiles, opts)) {
-    for (auto &unitPair : allUnits) {
-      for (auto stmt : unitPair.second.program) {
-        delete stmt;
+  if (!compileCSources(opts.cSourceFiles, cObjectFiles, pool, opts)) {
+    return 1;
+  }
+
+  if (opts.lto != LTOMode::None) {
+    // Whatever the C and prebuilt objects call must survive internalization.
+    std::vector<std::string> foreignObjects = cObjectFiles;
+    foreignObjects.insert(foreignObjects.end(), opts.objectFiles.begin(),
+                          opts.objectFiles.end());
+    std::set<std::string> preserved = getUndefinedSymbols(foreignObjects, opts);
+
+    if (opts.lto == LTOMode::Full) {
+      // One object for the whole program.
+      std::string ltoObject = getObjectFileName(opts.outputFile);
+      if (!linkFullLTO(order, preserved, ltoObject, opts)) {
+        return 1;
+      }
+      objectFiles.push_back(ltoObject);
+    } else if (!linkThinLTO(order, preserved, objectFiles, opts)) {
+      return 1;
+    }
+  } else {
+    // Collect ALL object files from all compiled units (including
+    // dependencies)
+    for (const auto &pair : allUnits) {
+      if (pair.second.compiled && fileExists(pair.second.objectFile)) {
+        objectFiles.push_back(pair.second.objectFile);
       }
     }
-    return 1;
   }
 
   objectFiles.insert(objectFiles.end(), cObjectFiles.begin(),
@@ -830,21 +2280,25 @@ int main(int argc, const char *argv[]) {
   if (!opts.noLink) {
     std::string execFile = getExecutableFileName(opts.outputFile);
     if (!linkExecutable(objectFiles, execFile, opts)) {
-
-      for (auto &unitPair : allUnits) {
-        for (auto stmt : unitPair.second.program) {
-          delete stmt;
-        }
-      }
       return 1;
     }
   }
 
-  for (auto &unitPair : allUnits) {
-    for (auto stmt : unitPair.second.program) {
-      delete stmt;
+  return 0;
+}
+
+int main(int argc, const char *argv[]) {
+  if (argc >= 2 && std::string(argv[1]) == "--server") {
+    std::string socketPath = argc >= 3 ? argv[2] : server::getSocketPath();
+    // Everything done here is inherited by every worker the server forks.
+    std::string error;
+    findTarget(llvm::Triple(llvm::sys::getDefaultTargetTriple()), error);
+#ifdef RACCOON_HAVE_LLD
+    if (auto clang = llvm::sys::findProgramByName("clang")) {
+      getLinkPlan(*clang, llvm::sys::getDefaultTargetTriple());
     }
+#endif
+    return runServer(socketPath, argv[0], runCompiler);
   }
-
-  return 0;
+  return runCompiler(argc, argv);
 }
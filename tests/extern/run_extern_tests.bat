@@ -79,7 +79,8 @@ call :run_test extern_pointers 99 test_extern_pointers.rac shim_pointers.c
 call :run_test extern_structs 42 test_extern_structs.rac shim_structs.c
 call :run_test extern_mixed 10 test_extern_mixed.rac shim_mixed.c
 
-del /q *.o *.racm 2>nul
+del /q *.o *.racm .racbuild 2>nul
+if exist .racobj rmdir /s /q .racobj
 
 echo ======================================
 echo C Interop Test Summary
@@ -71,7 +71,8 @@ run_test "extern_structs" 42 "test_extern_structs.rac" "shim_structs.c"
 run_test "extern_mixed" 10 "test_extern_mixed.rac" "shim_mixed.c"
 run_test "extern_void" 5 "test_extern_void.rac" "shim_void.c"
 
-rm -f *.o *.racm
+rm -f *.o *.racm .racbuild
+rm -rf .racobj
 
 echo "======================================"
 echo "C Interop Test Summary"
@@ -63,7 +63,8 @@ call :run_test complex_types 100 test_complex.rac
 call :run_test mixed_exports 11 test_mixed.rac
 call :run_test calculator 8 test_calculator.rac
 
-del /q *.racm 2>nul
+del /q *.racm .racbuild 2>nul
+if exist .racobj rmdir /s /q .racobj
 
 echo ======================================
 echo Module Test Summary
@@ -17,6 +17,7 @@ echo ""
 
 cd "$TEST_DIR" || exit 1
 
+# Compiles $3 with $MODULE_FLAGS and checks the program's exit code.
 run_test() {
     local test_name="$1"
     local expected_code="$2"
@@ -26,7 +27,7 @@ run_test() {
     echo "[$TOTAL] Testing: $test_name (expecting exit code: $expected_code)"
     
     local exe_file="test_${test_name}"
-    if ! "$COMPILER" -v "$main_file" -o "$exe_file" 2>&1 | head -20; then
+    if ! "$COMPILER" -v $MODULE_FLAGS "$main_file" -o "$exe_file" 2>&1 | head -20; then
         echo "  ✗ Compilation failed"
         FAILED=$((FAILED + 1))
         echo ""
@@ -58,7 +59,182 @@ run_test "complex_types" 100 "test_complex.rac"
 run_test "mixed_exports" 11 "test_mixed.rac"
 run_test "calculator" 8 "test_calculator.rac"
 
-rm -f *.racm
+# Incremental rebuilds. A generated three-module program (main imports twice,
+# both import counter) is rebuilt after each edit, and the number of modules
+# the compiler says it is compiling is checked. The compiler is run from a
+# copy, so that it can be made to look rebuilt.
+REBUILD_DIR="$(mktemp -d)"
+REBUILD_COMPILER="$REBUILD_DIR/raccoonc"
+cp "$COMPILER" "$REBUILD_COMPILER"
+
+# Writes counter.rac: $1 is bump's step, $2 an extra Counter field.
+write_counter() {
+    cat > "$REBUILD_DIR/counter.rac" <<RAC
+export struct Counter {
+    count: i32;$2
+}
+
+export fun make(start: i32): Counter {
+    let c: Counter;
+    c.count = start;
+    return c;
+}
+
+export fun bump(c: Counter*): i32 {
+    (*c).count = (*c).count + $1;
+    return (*c).count;
+}
+RAC
+}
+
+write_counter 1 ""
+cat > "$REBUILD_DIR/twice.rac" <<'RAC'
+import counter;
+
+export fun twice(c: counter.Counter*): i32 {
+    counter.bump(c);
+    return counter.bump(c);
+}
+RAC
+cat > "$REBUILD_DIR/main.rac" <<'RAC'
+import counter;
+import twice;
+
+fun main(): i32 {
+    let c: counter.Counter = counter.make(40);
+    return twice.twice(&c);
+}
+RAC
+
+# Rebuilds main.rac with $REBUILD_FLAGS and checks how many modules were
+# compiled, how many of those reused their cached IR, and what the program
+# returns.
+check_rebuild() {
+    local test_name="$1"
+    local expected_compiled="$2"
+    local expected_code="$3"
+    local expected_reused="${4:-0}"
+
+    TOTAL=$((TOTAL + 1))
+    echo "[$TOTAL] Testing: $test_name (expecting $expected_compiled compiled, exit code $expected_code)"
+
+    local output compiled reused
+    output=$(cd "$REBUILD_DIR" &&
+        "$REBUILD_COMPILER" -v $REBUILD_FLAGS main.rac -o main 2>&1)
+    compiled=$(echo "$output" | grep -c '^Compiling .*\.rac\.\.\.$' || true)
+    reused=$(echo "$output" | grep -c 'Reusing cached IR' || true)
+
+    set +e
+    (cd "$REBUILD_DIR" && ./main)
+    actual_code=$?
+    set -e
+
+    if [ "$compiled" -eq "$expected_compiled" ] &&
+        [ "$reused" -eq "$expected_reused" ] &&
+        [ "$actual_code" -eq "$expected_code" ]; then
+        echo "  ✓ Test passed ($compiled compiled, $reused from cached IR, exit code: $actual_code)"
+        PASSED=$((PASSED + 1))
+    else
+        echo "  ✗ Expected $expected_compiled compiled, $expected_reused from cached IR and exit code $expected_code, got $compiled, $reused and $actual_code"
+        echo "$output" | head -20
+        FAILED=$((FAILED + 1))
+    fi
+    echo ""
+}
+
+check_rebuild "rebuild_initial" 3 42
+check_rebuild "rebuild_unchanged" 0 42
+write_counter 2 ""
+check_rebuild "rebuild_body_edit" 1 44
+write_counter 2 "
+    limit: i32;"
+check_rebuild "rebuild_struct_edit" 3 44
+# Only code generation options changed: every module starts from its IR.
+REBUILD_FLAGS=-O2 check_rebuild "rebuild_opt_switch" 3 44 3
+# A rebuilt compiler may generate different IR, so none of it is reused.
+touch -t 200001010000 "$REBUILD_COMPILER"
+check_rebuild "rebuild_new_compiler" 3 44 0
+
+# Builds every module with one job and with several, and checks that the
+# compiler prints the same thing either way.
+check_jobs() {
+    local test_name="$1"
+    local jobs="$2"
+
+    TOTAL=$((TOTAL + 1))
+    echo "[$TOTAL] Testing: $test_name (expecting -j 1 and -j $jobs to match)"
+
+    local serial parallel
+    serial=$(cd "$REBUILD_DIR" &&
+        "$REBUILD_COMPILER" -f -j 1 main.rac -o main 2>&1)
+    parallel=$(cd "$REBUILD_DIR" &&
+        "$REBUILD_COMPILER" -f -j "$jobs" main.rac -o main 2>&1)
+
+    if [ "$serial" = "$parallel" ]; then
+        echo "  ✓ Test passed (output identical)"
+        PASSED=$((PASSED + 1))
+    else
+        echo "  ✗ Output differs between -j 1 and -j $jobs"
+        diff <(echo "$serial") <(echo "$parallel") | head -20
+        FAILED=$((FAILED + 1))
+    fi
+    echo ""
+}
+
+check_jobs "rebuild_parallel_output" 8
+# With link-time optimization every module is built to bitcode instead, and
+# the calls between them are resolved when those are linked together.
+REBUILD_FLAGS=--lto=full check_rebuild "rebuild_full_lto" 3 44
+REBUILD_FLAGS=--lto=full check_rebuild "rebuild_full_lto_unchanged" 0 44
+
+# Rebuilds main.rac with ThinLTO and a backend cache, and checks how many
+# modules went through the backend rather than coming out of the cache.
+check_thinlto() {
+    local test_name="$1"
+    local expected_backends="$2"
+    local expected_code="$3"
+    local cache_dir="$REBUILD_DIR/thinlto-cache"
+
+    TOTAL=$((TOTAL + 1))
+    echo "[$TOTAL] Testing: $test_name (expecting $expected_backends backend runs, exit code $expected_code)"
+
+    local before after output backends
+    before=$(ls "$cache_dir" 2>/dev/null | grep -c '^llvmcache-' || true)
+    output=$(cd "$REBUILD_DIR" &&
+        "$REBUILD_COMPILER" --lto=thin --thinlto-cache-dir "$cache_dir" \
+            main.rac -o main 2>&1)
+    after=$(ls "$cache_dir" 2>/dev/null | grep -c '^llvmcache-' || true)
+    backends=$((after - before))
+
+    set +e
+    (cd "$REBUILD_DIR" && ./main)
+    actual_code=$?
+    set -e
+
+    if [ "$backends" -eq "$expected_backends" ] &&
+        [ "$actual_code" -eq "$expected_code" ]; then
+        echo "  ✓ Test passed ($backends backend runs, exit code: $actual_code)"
+        PASSED=$((PASSED + 1))
+    else
+        echo "  ✗ Expected $expected_backends backend runs and exit code $expected_code, got $backends and $actual_code"
+        echo "$output" | head -20
+        FAILED=$((FAILED + 1))
+    fi
+    echo ""
+}
+
+check_thinlto "rebuild_thinlto_initial" 3 44
+check_thinlto "rebuild_thinlto_unchanged" 0 44
+# Nothing imports from main, so the other modules' backend results are reused.
+sed 's/counter.make(40)/counter.make(38)/' "$REBUILD_DIR/main.rac" \
+    > "$REBUILD_DIR/main.rac.new"
+mv "$REBUILD_DIR/main.rac.new" "$REBUILD_DIR/main.rac"
+check_thinlto "rebuild_thinlto_main_edit" 1 42
+
+rm -rf "$REBUILD_DIR"
+
+rm -f *.racm .racbuild
+rm -rf .racobj
 
 echo "======================================"
 echo "Module Test Summary"
@@ -0,0 +1,77 @@
+#!/bin/bash
+# Tests for features only available on x86 ELF targets (@target_clones).
+# Skipped on every other host.
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+COMPILER="${1:-$SCRIPT_DIR/../../build/raccoonc}"
+TEST_DIR="$(cd "$(dirname "$0")" && pwd)"
+
+PASSED=0
+FAILED=0
+TOTAL=0
+
+echo "======================================"
+echo "  Raccoon x86 ELF Test Suite"
+echo "======================================"
+echo ""
+
+if [ "$(uname -s)" != "Linux" ] || [ "$(uname -m)" != "x86_64" ]; then
+    echo "Skipping: these tests need an x86-64 Linux host"
+    exit 0
+fi
+
+echo "Using compiler: $COMPILER"
+echo "Test directory: $TEST_DIR"
+echo ""
+
+cd "$TEST_DIR" || exit 1
+
+for test_file in *.rac; do
+    TOTAL=$((TOTAL + 1))
+    test_name=$(basename "$test_file" .rac)
+
+    expected_code=$(head -n 5 "$test_file" | grep -E '//\s*EXPECT:\s*[0-9]+' | sed -E 's/.*EXPECT:[[:space:]]*([0-9]+).*/\1/' | head -n 1)
+    expected_code="${expected_code:-0}"
+
+    echo "[$TOTAL] Testing: $test_name (expecting exit code: $expected_code)"
+
+    exe_file="test_${test_name}"
+    if ! "$COMPILER" -v "$test_file" -o "$exe_file" 2>&1 | head -20 ||
+        [ ! -f "$exe_file" ]; then
+        echo "  ✗ Compilation failed"
+        FAILED=$((FAILED + 1))
+        echo ""
+        continue
+    fi
+
+    ./"$exe_file"
+    actual_code=$?
+
+    if [ "$actual_code" -eq "$expected_code" ]; then
+        echo "  ✓ Test passed (exit code: $actual_code)"
+        PASSED=$((PASSED + 1))
+    else
+        echo "  ✗ Exit code mismatch: expected $expected_code, got $actual_code"
+        FAILED=$((FAILED + 1))
+    fi
+
+    rm -f "$exe_file"
+    echo ""
+done
+
+rm -f *.o *.racm .racbuild
+rm -rf .racobj
+
+echo "======================================"
+echo "x86 ELF Test Summary"
+echo "======================================"
+echo "Total:  $TOTAL"
+echo "Passed: $PASSED"
+echo "Failed: $FAILED"
+echo "======================================"
+
+if [ $FAILED -gt 0 ]; then
+    exit 1
+else
+    exit 0
+fi